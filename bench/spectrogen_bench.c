@@ -0,0 +1,404 @@
+/*
+ * Benchmark of the spectrogram hot path
+ *
+ * Times each stage separately over a sweep of window widths, window
+ * functions and image sizes, on seeded synthetic samples, and prints
+ * percentiles as CSV or JSON.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include <SDL2/SDL.h>
+
+#include "fourier.h"
+#include "gradient.h"
+#include "layout.h"
+#include "samplesource.h"
+#include "spectrogram.h"
+
+struct BenchConfig
+{
+	size_t windowWidth;
+	enum WindowFunction windowFunction;
+	int width;
+	int height;
+};
+
+/**
+ * Timings of one stage in microseconds
+ */
+struct BenchStage
+{
+	char const* name;
+	double* times;
+	size_t nTimes;
+};
+
+/**
+ * Optional texture upload. Requires a video device.
+ */
+struct BenchUpload
+{
+	SDL_Window* window;
+	SDL_Renderer* renderer;
+};
+
+static char const* const windowNames[] = { "rect", "tri", "gauss", "expc" };
+
+static double bench_elapsed(Uint64 start)
+{
+	return (SDL_GetPerformanceCounter() - start) * 1e6 /
+	       (double) SDL_GetPerformanceFrequency();
+}
+/**
+ * @brief Deterministic xorshift64* generator, uniform on [0, 1)
+ */
+static double bench_random(uint64_t* const state)
+{
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return (*state * 2685821657736338717ull >> 11) * (1.0 / 9007199254740992.0);
+}
+/**
+ * @brief Segments of random sinusoid pairs over noise, like the default
+ *  samples of static mode but reproducible
+ */
+static void bench_samples(real* const samples, size_t n, uint64_t seed)
+{
+	uint64_t state = seed ? seed : 1;
+	size_t const segmentWidth = 4096;
+	real freq0 = 0, freq1 = 0;
+	for (size_t i = 0; i < n; ++i)
+	{
+		if (i % segmentWidth == 0)
+		{
+			freq0 = bench_random(&state);
+			freq1 = bench_random(&state);
+		}
+		samples[i] = cos(freq0 * i) + sin(freq1 * i) +
+		             0.01 * (bench_random(&state) - 0.5);
+	}
+}
+static int bench_compare(void const* a, void const* b)
+{
+	double const x = *(double const*) a;
+	double const y = *(double const*) b;
+	return (x > y) - (x < y);
+}
+/**
+ * @brief Nearest rank percentile of sorted times
+ */
+static double bench_percentile(double const* const times, size_t n, double p)
+{
+	size_t rank = (size_t) ceil(p / 100 * n);
+	if (rank < 1) rank = 1;
+	return times[rank - 1];
+}
+static void bench_report(struct BenchConfig const* const c,
+                         struct BenchStage* const stage, bool json,
+                         bool* const first)
+{
+	double* const t = stage->times;
+	size_t const n = stage->nTimes;
+	if (n == 0) return;
+	qsort(t, n, sizeof(double), bench_compare);
+	double mean = 0;
+	for (size_t i = 0; i < n; ++i)
+		mean += t[i];
+	mean /= n;
+
+	if (json)
+	{
+		printf("%s\n    {\"window_width\": %zu, \"window\": \"%s\", "
+		       "\"width\": %d, \"height\": %d, \"stage\": \"%s\", \"runs\": %zu, "
+		       "\"min_us\": %.3f, \"p50_us\": %.3f, \"p90_us\": %.3f, "
+		       "\"p99_us\": %.3f, \"max_us\": %.3f, \"mean_us\": %.3f}",
+		       *first ? "" : ",", c->windowWidth, windowNames[c->windowFunction],
+		       c->width, c->height, stage->name, n, t[0],
+		       bench_percentile(t, n, 50), bench_percentile(t, n, 90),
+		       bench_percentile(t, n, 99), t[n - 1], mean);
+	}
+	else
+	{
+		printf("%zu,%s,%d,%d,%s,%zu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+		       c->windowWidth, windowNames[c->windowFunction],
+		       c->width, c->height, stage->name, n, t[0],
+		       bench_percentile(t, n, 50), bench_percentile(t, n, 90),
+		       bench_percentile(t, n, 99), t[n - 1], mean);
+	}
+	*first = false;
+}
+
+/**
+ * @brief Times every stage of one configuration nRuns times
+ */
+static void bench_config(struct BenchConfig const* const c,
+                         struct SampleSource const* const source,
+                         struct ColourGradient const* const grad,
+                         size_t nThreads, size_t nRuns,
+                         struct BenchUpload const* const upload,
+                         bool json, bool* const first)
+{
+	enum
+	{
+		STAGE_PLAN,
+		STAGE_POPULATE,
+		STAGE_POPULATE_YUV,
+		STAGE_GRADIENT,
+		STAGE_UPLOAD,
+		STAGE_COUNT
+	};
+	static char const* const names[STAGE_COUNT] =
+	{
+		"dstft_init", "populate_rgb", "populate_yuv", "gradient_eval", "upload"
+	};
+	struct BenchStage stages[STAGE_COUNT];
+	for (int s = 0; s < STAGE_COUNT; ++s)
+	{
+		stages[s].name = names[s];
+		stages[s].times = malloc(sizeof(double) * nRuns);
+		stages[s].nTimes = 0;
+	}
+
+	// Planning from scratch, as on a launch without wisdom
+	for (size_t r = 0; r < nRuns; ++r)
+	{
+		FFTW(forget_wisdom)();
+		struct DSTFT d;
+		memset(&d, 0, sizeof(struct DSTFT));
+		d.windowWidth = c->windowWidth;
+		Uint64 const start = SDL_GetPerformanceCounter();
+		DSTFT_init(&d);
+		stages[STAGE_PLAN].times[stages[STAGE_PLAN].nTimes++] =
+		  bench_elapsed(start);
+		DSTFT_destroy(&d);
+	}
+
+	struct DSTFT dstfts[nThreads];
+	memset(&dstfts[0], 0, sizeof(struct DSTFT));
+	dstfts[0].windowWidth = c->windowWidth;
+	DSTFT_init(&dstfts[0]);
+	window_populate(dstfts[0].window, c->windowWidth, c->windowFunction, 6.0);
+	for (size_t i = 1; i < nThreads; ++i)
+		DSTFT_init_copy(&dstfts[i], &dstfts[0]);
+	struct WorkerPool pool;
+	pool.nThreads = nThreads;
+	WorkerPool_init(&pool);
+	dstfts[0].pool = &pool;
+	struct FrequencyLayout layout;
+	memset(&layout, 0, sizeof(struct FrequencyLayout));
+	layout.height = c->height;
+	layout.windowRadius = dstfts[0].windowRadius;
+	layout.axis = AXIS_LINEAR;
+	layout.aggregation = AGGREGATE_MAX;
+	FrequencyLayout_init(&layout);
+
+	size_t const nPixels = (size_t) c->width * c->height;
+	uint8_t* const rgb = malloc(3 * nPixels);
+	uint8_t* const yuv = malloc(nPixels * 3 / 2);
+	struct SpectrogramImage imageRGB;
+	memset(&imageRGB, 0, sizeof(struct SpectrogramImage));
+	imageRGB.format = SPECTROGRAM_RGB24;
+	imageRGB.planes[0] = rgb;
+	imageRGB.pitches[0] = 3 * c->width;
+	struct SpectrogramImage imageYUV;
+	imageYUV.format = SPECTROGRAM_YUV420P;
+	imageYUV.planes[0] = yuv;
+	imageYUV.planes[1] = yuv + nPixels;
+	imageYUV.planes[2] = yuv + nPixels + nPixels / 4;
+	imageYUV.pitches[0] = c->width;
+	imageYUV.pitches[1] = imageYUV.pitches[2] = c->width / 2;
+
+	SDL_Texture* texture = NULL;
+	if (upload)
+	{
+		texture = SDL_CreateTexture(upload->renderer, SDL_PIXELFORMAT_YV12,
+		                            SDL_TEXTUREACCESS_STREAMING,
+		                            c->width, c->height);
+		if (!texture) fprintf(stderr, "[SDL] %s\n", SDL_GetError());
+	}
+
+	for (size_t r = 0; r < nRuns; ++r)
+	{
+		Uint64 start = SDL_GetPerformanceCounter();
+		spectrogram_populate_image(&imageRGB, c->width, source, false,
+		                           &layout, grad, dstfts, nThreads);
+		stages[STAGE_POPULATE].times[stages[STAGE_POPULATE].nTimes++] =
+		  bench_elapsed(start);
+
+		start = SDL_GetPerformanceCounter();
+		spectrogram_populate_image(&imageYUV, c->width, source, false,
+		                           &layout, grad, dstfts, nThreads);
+		stages[STAGE_POPULATE_YUV].times[stages[STAGE_POPULATE_YUV].nTimes++] =
+		  bench_elapsed(start);
+
+		// One colour per pixel, over the whole domain of the gradient
+		start = SDL_GetPerformanceCounter();
+		for (size_t i = 0; i < nPixels; ++i)
+			ColourGradient_eval(grad, -14 + 15 * (i / (real) nPixels), rgb + 3 * i);
+		stages[STAGE_GRADIENT].times[stages[STAGE_GRADIENT].nTimes++] =
+		  bench_elapsed(start);
+
+		if (texture)
+		{
+			start = SDL_GetPerformanceCounter();
+			SDL_UpdateYUVTexture(texture, NULL,
+			                     imageYUV.planes[0], imageYUV.pitches[0],
+			                     imageYUV.planes[1], imageYUV.pitches[1],
+			                     imageYUV.planes[2], imageYUV.pitches[2]);
+			// Wait for the upload rather than timing its submission
+			SDL_RenderCopy(upload->renderer, texture, NULL, NULL);
+			SDL_RenderPresent(upload->renderer);
+			stages[STAGE_UPLOAD].times[stages[STAGE_UPLOAD].nTimes++] =
+			  bench_elapsed(start);
+		}
+	}
+
+	for (int s = 0; s < STAGE_COUNT; ++s)
+	{
+		bench_report(c, &stages[s], json, first);
+		free(stages[s].times);
+	}
+	if (texture) SDL_DestroyTexture(texture);
+	free(rgb);
+	free(yuv);
+	FrequencyLayout_destroy(&layout);
+	WorkerPool_destroy(&pool);
+	for (size_t i = 0; i < nThreads; ++i)
+		DSTFT_destroy(&dstfts[i]);
+}
+
+int main(int argc, char* argv[])
+{
+	size_t nRuns = 20;
+	size_t nThreads = 1;
+	size_t nSamples = 441000;
+	uint64_t seed = 1;
+	bool json = false;
+	bool quick = false;
+	bool uploadEnabled = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--help") == 0)
+		{
+			printf("Usage:\n"
+			       "--runs N: Number of timed runs per stage. Defaults to 20\n"
+			       "--threads N: Number of threads calculating the spectrogram\n"
+			       "--ns NSAMPLES: Number of synthetic samples\n"
+			       "--seed N: Seed of the synthetic samples\n"
+			       "--json: Print JSON instead of CSV\n"
+			       "--quick: Only sweep the default configuration\n"
+			       "--upload: Also time the texture upload. Requires a display\n"
+			      );
+			return 1;
+		}
+		else if (strcmp(argv[i], "--json") == 0)
+			json = true;
+		else if (strcmp(argv[i], "--quick") == 0)
+			quick = true;
+		else if (strcmp(argv[i], "--upload") == 0)
+			uploadEnabled = true;
+		else if (i + 1 < argc && strcmp(argv[i], "--runs") == 0)
+			nRuns = atol(argv[++i]);
+		else if (i + 1 < argc && strcmp(argv[i], "--threads") == 0)
+			nThreads = atol(argv[++i]);
+		else if (i + 1 < argc && strcmp(argv[i], "--ns") == 0)
+			nSamples = atol(argv[++i]);
+		else if (i + 1 < argc && strcmp(argv[i], "--seed") == 0)
+			seed = strtoull(argv[++i], NULL, 10);
+		else
+		{
+			fprintf(stderr, "Unknown argument\n");
+			return -1;
+		}
+	}
+	if (nRuns == 0 || nThreads == 0)
+	{
+		fprintf(stderr, "Runs and threads must be positive\n");
+		return -1;
+	}
+
+	static size_t const windowWidths[] = { 512, 1536, 4096 };
+	static enum WindowFunction const windowFunctions[] =
+	{
+		WINDOW_RECT, WINDOW_GAUSSIAN, WINDOW_EXPCAUSAL
+	};
+	static int const sizes[][2] = { { 320, 240 }, { 640, 480 }, { 1280, 720 } };
+	size_t const nWidths = quick ? 1 : sizeof(windowWidths) / sizeof(size_t);
+	size_t const nFunctions = quick ? 1 : sizeof(windowFunctions) /
+	                                      sizeof(enum WindowFunction);
+	size_t const nSizes = quick ? 1 : sizeof(sizes) / sizeof(sizes[0]);
+	size_t const widest = windowWidths[quick ? 1 : nWidths - 1];
+	if (nSamples < widest)
+	{
+		fprintf(stderr, "Sample size cannot be smaller than the window width\n");
+		return -1;
+	}
+
+	struct BenchUpload upload;
+	struct BenchUpload* uploadUsed = NULL;
+	if (uploadEnabled)
+	{
+		if (SDL_Init(SDL_INIT_VIDEO) != 0 ||
+		    !(upload.window = SDL_CreateWindow("spectrogen_bench",
+		                                       SDL_WINDOWPOS_UNDEFINED,
+		                                       SDL_WINDOWPOS_UNDEFINED,
+		                                       1280, 720, SDL_WINDOW_HIDDEN)) ||
+		    !(upload.renderer = SDL_CreateRenderer(upload.window, -1, 0)))
+		{
+			fprintf(stderr, "[SDL] %s\n", SDL_GetError());
+			return -1;
+		}
+		uploadUsed = &upload;
+	}
+
+	real* const samples = malloc(sizeof(real) * nSamples);
+	bench_samples(samples, nSamples, seed);
+	struct SampleSource source;
+	SampleSource_init_array(&source, samples, nSamples);
+	struct ColourGradient grad;
+	ColourGradient_init_preset(&grad);
+
+	if (json)
+	{
+		printf("{\n  \"precision\": \"%s\", \"threads\": %zu, \"samples\": %zu,"
+		       " \"seed\": %llu,\n  \"results\": [",
+		       sizeof(real) == sizeof(float) ? "float" : "double",
+		       nThreads, nSamples, (unsigned long long) seed);
+	}
+	else
+	{
+		printf("window_width,window,width,height,stage,runs,"
+		       "min_us,p50_us,p90_us,p99_us,max_us,mean_us\n");
+	}
+	bool first = true;
+	for (size_t w = 0; w < nWidths; ++w)
+	for (size_t f = 0; f < nFunctions; ++f)
+	for (size_t s = 0; s < nSizes; ++s)
+	{
+		struct BenchConfig c;
+		c.windowWidth = windowWidths[quick ? 1 : w];
+		c.windowFunction = windowFunctions[quick ? 1 : f];
+		c.width = sizes[quick ? 1 : s][0];
+		c.height = sizes[quick ? 1 : s][1];
+		bench_config(&c, &source, &grad, nThreads, nRuns, uploadUsed,
+		             json, &first);
+		fflush(stdout);
+	}
+	if (json) printf("\n  ]\n}\n");
+
+	ColourGradient_destroy(&grad);
+	free(samples);
+	if (uploadUsed)
+	{
+		SDL_DestroyRenderer(upload.renderer);
+		SDL_DestroyWindow(upload.window);
+		SDL_Quit();
+	}
+	return 0;
+}
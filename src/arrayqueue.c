@@ -30,6 +30,7 @@ bool ArrayQueue_enqueue(struct ArrayQueue* const q, void* data, size_t size)
 	if (!l) return false;
 
 	l->data = data;
+	l->size = size;
 	l->next = NULL;
 
 	SDL_LockMutex(q->mutex);
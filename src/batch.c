@@ -0,0 +1,386 @@
+#include "batch.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <SDL2/SDL.h>
+
+#include "arrayqueue.h"
+#include "spectrogram.h"
+
+/**
+ * The files [begin, end) of the list not taken yet. The owning thread takes
+ * from the front and thieves take from the back.
+ */
+struct BatchDeque
+{
+	SDL_SpinLock lock;
+	size_t begin, end;
+};
+/**
+ * A rendered image waiting to be written
+ */
+struct BatchOutput
+{
+	char* fileName;
+	uint8_t* rgb;
+};
+struct Batch
+{
+	struct Spectrogen* spectrogen;
+	char** files;
+	/**
+	 * The image of each file
+	 */
+	char** outputNames;
+	size_t nFiles;
+	enum SampleFileType fileType;
+	char const* outputDir;
+	enum ImageFileType outputType;
+
+	/**
+	 * One deque per thread of spectrogen
+	 */
+	struct BatchDeque* deques;
+	/**
+	 * struct BatchOutput, ended by NULL
+	 */
+	struct ArrayQueue outputs;
+	/**
+	 * Images which may be rendered and not yet written. Taken by the workers
+	 * before rendering and posted by the writer. NULL if the writer runs after
+	 * the workers.
+	 */
+	SDL_sem* slots;
+
+	_Atomic size_t nWritten;
+	_Atomic size_t nFailed;
+	_Atomic size_t nSamples;
+};
+struct BatchWorker
+{
+	struct Batch* batch;
+	size_t index;
+};
+
+static int batch_compare(void const* a, void const* b)
+{
+	return strcmp(*(char* const*) a, *(char* const*) b);
+}
+/**
+ * @brief Appends a copy of fileName to the list
+ */
+static void batch_list_append(char*** const files, size_t* const nFiles,
+                              size_t* const capacity, char const* const fileName)
+{
+	if (*nFiles == *capacity)
+	{
+		*capacity = *capacity ? 2 * *capacity : 64;
+		*files = realloc(*files, sizeof(char*) * *capacity);
+	}
+	(*files)[(*nFiles)++] = strdup(fileName);
+}
+/**
+ * @brief Reads the file names of a list, see batch_exec
+ * @return NULL if the list cannot be read. The error is printed to stderr.
+ */
+static char** batch_list(char const* const listName, size_t* const nFiles)
+{
+	char** files = NULL;
+	size_t capacity = 0;
+	*nFiles = 0;
+
+	struct stat info;
+	if (stat(listName, &info) != 0)
+	{
+		perror(listName);
+		return NULL;
+	}
+	if (S_ISDIR(info.st_mode))
+	{
+		DIR* const dir = opendir(listName);
+		if (!dir)
+		{
+			perror(listName);
+			return NULL;
+		}
+		struct dirent* entry;
+		while ((entry = readdir(dir)))
+		{
+			char path[strlen(listName) + strlen(entry->d_name) + 2];
+			sprintf(path, "%s/%s", listName, entry->d_name);
+			if (stat(path, &info) == 0 && S_ISREG(info.st_mode))
+				batch_list_append(&files, nFiles, &capacity, path);
+		}
+		closedir(dir);
+		// Directory order is arbitrary
+		if (*nFiles) qsort(files, *nFiles, sizeof(char*), batch_compare);
+	}
+	else
+	{
+		FILE* const list = fopen(listName, "r");
+		if (!list)
+		{
+			perror(listName);
+			return NULL;
+		}
+		char* line = NULL;
+		size_t lineSize = 0;
+		ssize_t length;
+		while ((length = getline(&line, &lineSize, list)) != -1)
+		{
+			while (length > 0 &&
+			       (line[length - 1] == '\n' || line[length - 1] == '\r'))
+				line[--length] = '\0';
+			if (length > 0)
+				batch_list_append(&files, nFiles, &capacity, line);
+		}
+		free(line);
+		fclose(list);
+	}
+	if (*nFiles == 0)
+	{
+		fprintf(stderr, "%s: No files to render\n", listName);
+		free(files);
+		return NULL;
+	}
+	return files;
+}
+/**
+ * @brief outputDir/NAME.EXT for the input file DIR/NAME. The extension of
+ *  the input is kept, so a.wav and a.txt render to different images.
+ */
+static char* batch_output_name(struct Batch const* const b,
+                               char const* const fileName)
+{
+	static char const* const extensions[] = { ".ppm", ".png", ".raw" };
+	char const* name = strrchr(fileName, '/');
+	name = name ? name + 1 : fileName;
+
+	char const* const extension = extensions[b->outputType];
+	size_t const size = strlen(b->outputDir) + strlen(name) +
+	                    strlen(extension) + 2;
+	char* const result = malloc(size);
+	snprintf(result, size, "%s/%s%s", b->outputDir, name, extension);
+	return result;
+}
+/**
+ * @brief Populates b->outputNames
+ * @return false if files of the list in different directories render to the
+ *  same image. The collisions are printed to stderr.
+ */
+static bool batch_output_names(struct Batch* const b)
+{
+	b->outputNames = malloc(sizeof(char*) * b->nFiles);
+	char** const sorted = malloc(sizeof(char*) * b->nFiles);
+	for (size_t i = 0; i < b->nFiles; ++i)
+		sorted[i] = b->outputNames[i] = batch_output_name(b, b->files[i]);
+	qsort(sorted, b->nFiles, sizeof(char*), batch_compare);
+	bool unique = true;
+	for (size_t i = 1; i < b->nFiles; ++i)
+	{
+		if (strcmp(sorted[i - 1], sorted[i]) == 0 &&
+		    (i == 1 || strcmp(sorted[i - 2], sorted[i]) != 0))
+		{
+			fprintf(stderr, "%s: Rendered from several files\n", sorted[i]);
+			unique = false;
+		}
+	}
+	free(sorted);
+	return unique;
+}
+
+/**
+ * @brief Takes a file from the front, or from the back if steal is true
+ */
+static bool batch_take(struct BatchDeque* const q, size_t* const file,
+                       bool steal)
+{
+	SDL_AtomicLock(&q->lock);
+	bool const found = q->begin < q->end;
+	if (found) *file = steal ? --q->end : q->begin++;
+	SDL_AtomicUnlock(&q->lock);
+	return found;
+}
+static void batch_render(struct Batch* const b, struct DSTFT* const dstft,
+                         size_t file)
+{
+	struct Spectrogen const* const s = b->spectrogen;
+	char const* const fileName = b->files[file];
+	struct SampleSource source;
+	if (!SampleSource_open(&source, fileName, b->fileType, NULL))
+	{
+		// The error above does not name the file
+		fprintf(stderr, "%s: Skipped\n", fileName);
+		++b->nFailed;
+		return;
+	}
+	if (source.nSamples < dstft->windowWidth)
+	{
+		fprintf(stderr, "%s: Number of samples cannot be less than the window"
+		        " width\n", fileName);
+		SampleSource_close(&source);
+		++b->nFailed;
+		return;
+	}
+
+	if (b->slots) SDL_SemWait(b->slots);
+	size_t const size = 3 * (size_t) s->width * s->height;
+	struct BatchOutput* const output = malloc(sizeof(struct BatchOutput));
+	output->rgb = malloc(size);
+	output->fileName = strdup(b->outputNames[file]);
+	struct SpectrogramImage image;
+	memset(&image, 0, sizeof(struct SpectrogramImage));
+	image.format = SPECTROGRAM_RGB24;
+	image.planes[0] = output->rgb;
+	image.pitches[0] = s->width * 3;
+	spectrogram_populate_image(&image, s->width, &source, false,
+	                           &s->layout, &s->grad, dstft, 1);
+	b->nSamples += source.nSamples;
+	SampleSource_close(&source);
+
+	if (!ArrayQueue_enqueue(&b->outputs, output, size))
+	{
+		// The writer will never see the image, so its slot is returned here
+		fprintf(stderr, "%s: Unable to queue the image\n", fileName);
+		free(output->fileName);
+		free(output->rgb);
+		free(output);
+		if (b->slots) SDL_SemPost(b->slots);
+		++b->nFailed;
+	}
+}
+static int batch_worker(struct BatchWorker* const w)
+{
+	struct Batch* const b = w->batch;
+	size_t const nThreads = b->spectrogen->nThreads;
+	struct DSTFT* const dstft = &b->spectrogen->dstfts[w->index];
+	while (true)
+	{
+		size_t file;
+		bool found = batch_take(&b->deques[w->index], &file, false);
+		for (size_t k = 1; k < nThreads && !found; ++k)
+			found = batch_take(&b->deques[(w->index + k) % nThreads], &file, true);
+		if (!found) break;
+		batch_render(b, dstft, file);
+	}
+	return 0;
+}
+static int batch_writer(struct Batch* const b)
+{
+	_Atomic bool const running = false;
+	while (true)
+	{
+		void* data;
+		size_t size;
+		ArrayQueue_dequeue(&b->outputs, &data, &size, true, &running);
+		struct BatchOutput* const output = data;
+		if (!output) break;
+		struct Spectrogen const* const s = b->spectrogen;
+		if (image_write(output->fileName, b->outputType, output->rgb,
+		                s->width, s->height))
+			++b->nWritten;
+		else
+			++b->nFailed;
+		free(output->fileName);
+		free(output->rgb);
+		free(output);
+		if (b->slots) SDL_SemPost(b->slots);
+	}
+	return 0;
+}
+
+bool batch_exec(struct Spectrogen* const s,
+                char const* const listName, enum SampleFileType fileType,
+                char const* const outputDir, enum ImageFileType outputType)
+{
+	assert(s && s->dstfts);
+	struct Batch b;
+	memset(&b, 0, sizeof(struct Batch));
+	b.files = batch_list(listName, &b.nFiles);
+	if (!b.files) return false;
+	b.spectrogen = s;
+	b.fileType = fileType;
+	b.outputDir = outputDir;
+	b.outputType = outputType;
+	bool const unique = batch_output_names(&b);
+	if (!unique)
+	{
+		for (size_t i = 0; i < b.nFiles; ++i)
+		{
+			free(b.files[i]);
+			free(b.outputNames[i]);
+		}
+		free(b.files);
+		free(b.outputNames);
+		return false;
+	}
+	ArrayQueue_init(&b.outputs);
+
+	size_t const nThreads = s->nThreads;
+	b.deques = malloc(sizeof(struct BatchDeque) * nThreads);
+	for (size_t t = 0; t < nThreads; ++t)
+	{
+		b.deques[t].lock = 0;
+		b.deques[t].begin = b.nFiles * t / nThreads;
+		b.deques[t].end = b.nFiles * (t + 1) / nThreads;
+	}
+
+	Uint64 const timeStart = SDL_GetPerformanceCounter();
+	// Two images per worker keep the writer busy without piling up images
+	b.slots = SDL_CreateSemaphore(2 * nThreads);
+	SDL_Thread* const writer =
+	  SDL_CreateThread((SDL_ThreadFunction) batch_writer, "writer", &b);
+	if (!writer && b.slots)
+	{
+		SDL_DestroySemaphore(b.slots);
+		b.slots = NULL;
+	}
+	struct BatchWorker workers[nThreads];
+	SDL_Thread* threads[nThreads];
+	for (size_t t = 0; t < nThreads; ++t)
+	{
+		workers[t].batch = &b;
+		workers[t].index = t;
+	}
+	for (size_t t = 1; t < nThreads; ++t)
+	{
+		threads[t] = SDL_CreateThread((SDL_ThreadFunction) batch_worker,
+		                              "batch", &workers[t]);
+		// Fall back to the calling thread
+		if (!threads[t]) batch_worker(&workers[t]);
+	}
+	batch_worker(&workers[0]);
+	for (size_t t = 1; t < nThreads; ++t)
+	{
+		if (threads[t]) SDL_WaitThread(threads[t], NULL);
+	}
+	ArrayQueue_enqueue(&b.outputs, NULL, 0);
+	if (writer) SDL_WaitThread(writer, NULL);
+	else batch_writer(&b);
+	double const seconds = (SDL_GetPerformanceCounter() - timeStart) /
+	                       (double) SDL_GetPerformanceFrequency();
+
+	size_t const nWritten = b.nWritten;
+	size_t const nFailed = b.nFailed;
+	fprintf(stdout, "Rendered %zu files (%zu failed) in %.3f s: "
+	        "%.2f files/s, %.4g samples/s\n",
+	        nWritten, nFailed, seconds,
+	        nWritten / seconds, (double) b.nSamples / seconds);
+
+	ArrayQueue_destroy(&b.outputs);
+	if (b.slots) SDL_DestroySemaphore(b.slots);
+	free(b.deques);
+	for (size_t i = 0; i < b.nFiles; ++i)
+	{
+		free(b.files[i]);
+		free(b.outputNames[i]);
+	}
+	free(b.files);
+	free(b.outputNames);
+	return nFailed == 0;
+}
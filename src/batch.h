@@ -0,0 +1,28 @@
+#ifndef SPECTROGEN__BATCH_H_
+#define SPECTROGEN__BATCH_H_
+
+#include <stdbool.h>
+
+#include "imagefile.h"
+#include "libspectrogen.h"
+#include "samplesource.h"
+
+/**
+ * @brief Renders the spectrogram of every file in a list, writing image
+ *  outputDir/NAME.EXT for the input file DIR/NAME
+ *
+ * Each of the nThreads threads of the Spectrogen renders one file at a time
+ * with its own workspace. The workspaces share the plans and the window.
+ * Idle threads steal files from busy ones. The images are written by a
+ * separate thread, with at most 2 * nThreads images rendered and not yet
+ * written.
+ * @param[in] listName A directory, whose regular files are rendered, or a
+ *  text file with one file name per line
+ * @return false if the list cannot be read, files in different directories
+ *  have the same name, or any file fails
+ */
+bool batch_exec(struct Spectrogen* const,
+                char const* const listName, enum SampleFileType fileType,
+                char const* const outputDir, enum ImageFileType outputType);
+
+#endif // !SPECTROGEN__BATCH_H_
@@ -0,0 +1,166 @@
+#include "constantq.h"
+
+#include <assert.h>
+#include <tgmath.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simd.h"
+
+/**
+ * The kernel of a row spanning b components has CONSTANTQ_LOBE * n / b
+ * samples, so the half power width of its Hann window matches the row
+ */
+#define CONSTANTQ_LOBE 2.0
+/**
+ * Weights below this fraction of the largest weight of a kernel are dropped
+ */
+#define CONSTANTQ_THRESHOLD 1e-3
+
+/**
+ * @brief Component k of the transform of a complex sequence, whose real and
+ *  imaginary parts transform to re and im
+ */
+static comp constantq_component(comp const* const re, comp const* const im,
+                                size_t n, size_t k)
+{
+	k %= n;
+	if (k <= n / 2) return re[k] + I * im[k];
+	return conj(re[n - k]) + I * conj(im[n - k]);
+}
+
+bool ConstantQ_init(struct ConstantQ* const cq,
+                    struct FrequencyLayout const* const layout,
+                    struct DSTFT* const dstft)
+{
+	assert(cq && layout && layout->binBegin);
+	assert(layout->axis == AXIS_CONSTANT_Q);
+	assert(dstft && dstft->window);
+	assert(layout->windowRadius == dstft->windowRadius);
+	size_t const n = dstft->windowWidth;
+	size_t const radius = dstft->windowRadius;
+	real const* const window = dstft->window;
+	for (size_t m = 0; m < n; ++m)
+	{
+		if (window[m] == 0) return false;
+	}
+
+	memset(cq, 0, sizeof(struct ConstantQ));
+	cq->height = layout->height;
+	cq->windowRadius = radius;
+	cq->entryBegin = malloc(sizeof(size_t) * (layout->height + 1));
+	size_t capacity = 0;
+
+	comp* const re = malloc(sizeof(comp) * (radius + 1));
+	comp* const im = malloc(sizeof(comp) * (radius + 1));
+	comp* const weights = malloc(sizeof(comp) * (radius + 1));
+	comp* const conjWeights = malloc(sizeof(comp) * (radius + 1));
+	real* const buffer = dstft->buffer;
+	for (int row = 0; row < layout->height; ++row)
+	{
+		cq->entryBegin[row] = cq->nEntries;
+		// Row 0 is the highest frequency
+		real const bottom = (layout->height - 1 - row) / (real) layout->height;
+		real const top = (layout->height - row) / (real) layout->height;
+		double const frequency =
+		  FrequencyLayout_component(layout, (bottom + top) / 2);
+		double const bandwidth = FrequencyLayout_component(layout, top) -
+		                         FrequencyLayout_component(layout, bottom);
+		double const lengthReal = CONSTANTQ_LOBE * n / bandwidth;
+		size_t length = lengthReal < n ? (size_t) lengthReal : n;
+		if (length < 2) length = 2;
+		size_t const begin = radius - length / 2;
+
+		/*
+		 * The kernel h is a Hann window modulated to frequency, with phase 0 at
+		 * the centre. The frame holds the samples multiplied by the window of
+		 * dstft, read backwards, which the kernel divides out.
+		 */
+		double sum = 0;
+		for (size_t i = 0; i < length; ++i)
+		{
+			double const s = sin(M_PI * (i + 0.5) / length);
+			sum += s * s;
+		}
+		for (int part = 0; part < 2; ++part)
+		{
+			memset(buffer, 0, sizeof(real) * n);
+			for (size_t i = 0; i < length; ++i)
+			{
+				size_t const m = begin + i;
+				double const s = sin(M_PI * (i + 0.5) / length);
+				double const phase = -2 * M_PI * frequency *
+				                     ((double) m - (double) radius) / n;
+				double const h = part ? sin(phase) : cos(phase);
+				buffer[m] = s * s / sum * h / window[n - 1 - m];
+			}
+			FFTW(execute_dft_r2c)(dstft->plan, buffer, dstft->spectrum);
+			memcpy(part ? im : re, dstft->spectrum, sizeof(comp) * (radius + 1));
+		}
+
+		/*
+		 * The sum of h[m] x[m] over the frame is the sum of F[k] G[n - k] / n
+		 * over all components, where F and G transform the frame and h divided
+		 * by the window. Since the frame is real, F[n - k] = conj(F[k]) folds
+		 * the components above radius onto conj(F[n - k]).
+		 */
+		double largest = 0;
+		for (size_t k = 0; k <= radius; ++k)
+		{
+			weights[k] = constantq_component(re, im, n, n - k) / (real) n;
+			conjWeights[k] = k >= 1 && k < n - radius ?
+			                 constantq_component(re, im, n, k) / (real) n : 0;
+			double const magnitude = fmax(cabs(weights[k]), cabs(conjWeights[k]));
+			if (magnitude > largest) largest = magnitude;
+		}
+		for (size_t k = 0; k <= radius; ++k)
+		{
+			if (fmax(cabs(weights[k]), cabs(conjWeights[k])) <
+			    CONSTANTQ_THRESHOLD * largest)
+				continue;
+			if (cq->nEntries == capacity)
+			{
+				capacity = capacity ? 2 * capacity : 1024;
+				cq->bins = realloc(cq->bins, sizeof(size_t) * capacity);
+				cq->weights = realloc(cq->weights, sizeof(comp) * capacity);
+				cq->conjWeights = realloc(cq->conjWeights, sizeof(comp) * capacity);
+			}
+			cq->bins[cq->nEntries] = k;
+			cq->weights[cq->nEntries] = weights[k];
+			cq->conjWeights[cq->nEntries] = conjWeights[k];
+			++cq->nEntries;
+		}
+	}
+	cq->entryBegin[layout->height] = cq->nEntries;
+	memset(buffer, 0, sizeof(real) * n);
+
+	free(re);
+	free(im);
+	free(weights);
+	free(conjWeights);
+	return true;
+}
+void ConstantQ_destroy(struct ConstantQ* const cq)
+{
+	if (!cq) return;
+	free(cq->entryBegin);
+	free(cq->bins);
+	free(cq->weights);
+	free(cq->conjWeights);
+}
+void ConstantQ_eval(struct ConstantQ const* const cq,
+                    real* const amplitudes, comp const* const spectrum)
+{
+	assert(cq && cq->entryBegin);
+	for (int row = 0; row < cq->height; ++row)
+	{
+		comp sum = 0;
+		for (size_t e = cq->entryBegin[row]; e < cq->entryBegin[row + 1]; ++e)
+		{
+			comp const x = spectrum[cq->bins[e]];
+			sum += cq->weights[e] * x + cq->conjWeights[e] * conj(x);
+		}
+		amplitudes[row] = creal(sum) * creal(sum) + cimag(sum) * cimag(sum);
+	}
+	simd_log_amplitude(amplitudes, cq->height);
+}
@@ -0,0 +1,61 @@
+#ifndef SPECTROGEN__CONSTANTQ_H_
+#define SPECTROGEN__CONSTANTQ_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "fourier.h"
+#include "layout.h"
+
+/**
+ * Sparse spectral kernels computing one component per row of a layout from
+ * the spectrum of a frame, after Brown and Puckette.
+ *
+ * The kernel of a row is a Hann window centred on the frame and modulated to
+ * the frequency at the middle of the row. Its length is inversely
+ * proportional to the bandwidth of the row, up to the window width, so low
+ * rows get the full frequency resolution of the frame and high rows a finer
+ * time resolution. A row is the inner product of its kernel with the samples,
+ * evaluated on the spectrum of the windowed frame, where the kernel only has a
+ * few components of significant weight.
+ */
+struct ConstantQ
+{
+	// Populated by ConstantQ_init
+	int height;
+	size_t windowRadius;
+	/**
+	 * Row i reads the entries [entryBegin[i], entryBegin[i + 1])
+	 */
+	size_t* entryBegin;
+	/**
+	 * The entry e adds weights[e] * X + conjWeights[e] * conj(X), where X is
+	 * the component bins[e] of the spectrum
+	 */
+	size_t* bins;
+	comp* weights;
+	comp* conjWeights;
+	size_t nEntries;
+};
+
+/**
+ * The kernels absorb the window of dstft, which therefore cannot have zeros.
+ * The plan and buffers of dstft are used to transform the kernels.
+ * @brief Computes the kernels of the rows of layout, which must be on
+ *  AXIS_CONSTANT_Q
+ * @return false if the window of dstft has zeros. Nothing is allocated then.
+ */
+bool ConstantQ_init(struct ConstantQ* const,
+                    struct FrequencyLayout const* const layout,
+                    struct DSTFT* const dstft);
+void ConstantQ_destroy(struct ConstantQ* const);
+/**
+ * @brief Computes the log amplitude of each row, scaled so that a sinusoid
+ *  with unit amplitude maps to 0. See FrequencyLayout_eval.
+ * @param[out] amplitudes An array of size height
+ * @param[in] spectrum A spectrum of windowRadius + 1 components
+ */
+void ConstantQ_eval(struct ConstantQ const* const,
+                    real* const amplitudes, comp const* const spectrum);
+
+#endif // !SPECTROGEN__CONSTANTQ_H_
@@ -1,43 +1,89 @@
 #include "display.h"
 
 #include <assert.h>
+#include <stdatomic.h>
 
 void Display_init(struct Display* const d)
 {
 	assert(d);
 	memset(d, 0, sizeof(struct Display));
-	d->pictQueueMutex = SDL_CreateMutex();
-	d->pictQueueCond = SDL_CreateCond();
+	d->pictQueueMode = PICTQUEUE_FIFO;
+	d->pictQueueDepth = 2;
+	d->fps = 25;
+#ifdef SPECTROGEN_PROFILE
+	Profile_init(&d->profile);
+#endif
 }
 void Display_destroy(struct Display* const d)
 {
 	if (!d) return;
 	ColourGradient_destroy(&d->colourGradient);
-	SDL_DestroyMutex(d->pictQueueMutex);
-	SDL_DestroyCond(d->pictQueueCond);
-	sws_freeContext(d->swsContext);
+	FrequencyLayout_destroy(&d->frequencyLayout);
 	SDL_DestroyWindow(d->window);
+#ifdef SPECTROGEN_PROFILE
+	Profile_destroy(&d->profile);
+#endif
+}
+/**
+ * Render thread only
+ * @brief Maps the texture of p so the writing thread can fill its planes
+ */
+static bool Display_picture_map(struct Display* const d, struct Picture* const p)
+{
+	void* pixels;
+	int pitch;
+	if (SDL_LockTexture(p->texture, NULL, &pixels, &pitch) != 0)
+	{
+		fprintf(stderr, "[SDL] %s\n", SDL_GetError());
+		return false;
+	}
+	// YV12 stores the planes in the order Y, V, U
+	p->pitchY = pitch;
+	p->pitchUV = pitch / 2;
+	p->planeY = pixels;
+	p->planeV = p->planeY + pitch * d->height;
+	p->planeU = p->planeV + p->pitchUV * (d->height / 2);
+	return true;
 }
 bool Display_pictQueue_init(struct Display* const d)
 {
 	assert(d);
 	assert(d->window);
 	assert(d->width != 0 && d->height != 0);
-	d->renderer = SDL_CreateRenderer(d->window, -1, 0);
+	if (d->pictQueueMode == PICTQUEUE_LATEST)
+		d->pictQueueDepth = 3;
+	assert(d->pictQueueDepth >= 1 &&
+	       d->pictQueueDepth <= DISPLAY_PICTQUEUE_SIZE_MAX);
+	d->pictQueueIR = d->pictQueueIW = 0;
+	d->pictQueueFront = 0;
+	d->pictQueueBack = 1;
+	d->pictQueueLatest = 2;
+	d->pictQueueFree = SDL_CreateSemaphore(d->pictQueueDepth);
+	d->renderer = SDL_CreateRenderer(d->window, -1,
+	                                 d->vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
 	// YYYYUV Format
 	size_t planeSizeY = d->width * d->height;
 	size_t planeSizeUV = planeSizeY / 4;
-	d->texture = SDL_CreateTexture(d->renderer, SDL_PIXELFORMAT_YV12,
-	                               SDL_TEXTUREACCESS_STREAMING,
-	                               d->width, d->height);
-	if (!d->texture)
+	if (!d->zeroCopy)
 	{
-		SDL_DestroyRenderer(d->renderer);
-		return false;
+		d->texture = SDL_CreateTexture(d->renderer, SDL_PIXELFORMAT_YV12,
+		                               SDL_TEXTUREACCESS_STREAMING,
+		                               d->width, d->height);
+		if (!d->texture) goto fail;
 	}
-	for (size_t i = 0; i < DISPLAY_PICTQUEUE_SIZE_MAX; ++i)
+	for (size_t i = 0; i < d->pictQueueDepth; ++i)
 	{
 		struct Picture* const p = &d->pictQueue[i];
+		if (d->zeroCopy)
+		{
+			p->texture = SDL_CreateTexture(d->renderer, SDL_PIXELFORMAT_YV12,
+			                               SDL_TEXTUREACCESS_STREAMING,
+			                               d->width, d->height);
+			if (!p->texture || !Display_picture_map(d, p)) goto fail;
+			continue;
+		}
+		p->pitchY = d->width;
+		p->pitchUV = d->width / 2;
 		p->planeY = malloc(sizeof(*p->planeY) * planeSizeY);
 		p->planeU = malloc(sizeof(*p->planeU) * planeSizeUV);
 		p->planeV = malloc(sizeof(*p->planeV) * planeSizeUV);
@@ -51,75 +97,171 @@ fail:
 void Display_pictQueue_destroy(struct Display* const d)
 {
 	assert(d);
-	SDL_DestroyRenderer(d->renderer);
-	SDL_DestroyTexture(d->texture);
-	for (size_t i = 0; i < DISPLAY_PICTQUEUE_SIZE_MAX; ++i)
+	for (size_t i = 0; i < d->pictQueueDepth; ++i)
 	{
 		struct Picture* const p = &d->pictQueue[i];
-		free(p->planeY);
-		free(p->planeU);
-		free(p->planeV);
+		if (d->zeroCopy)
+		{
+			if (p->texture) SDL_DestroyTexture(p->texture);
+			p->texture = NULL;
+		}
+		else
+		{
+			free(p->planeY);
+			free(p->planeU);
+			free(p->planeV);
+		}
+		p->planeY = p->planeU = p->planeV = NULL;
 	}
+	if (d->texture) SDL_DestroyTexture(d->texture);
+	if (d->renderer) SDL_DestroyRenderer(d->renderer);
+	if (d->pictQueueFree) SDL_DestroySemaphore(d->pictQueueFree);
+	// A second call does nothing
+	d->texture = NULL;
+	d->renderer = NULL;
+	d->pictQueueFree = NULL;
 }
-bool Display_pictQueue_write(struct Display* const d)
+struct Picture* Display_pictQueue_write(struct Display* const d)
 {
 	assert(d);
-	SDL_LockMutex(d->pictQueueMutex);
-	while (d->pictQueueSize >= DISPLAY_PICTQUEUE_SIZE_MAX &&
-	       !d->quit)
+	if (d->pictQueueMode == PICTQUEUE_LATEST)
+		return d->quit ? NULL : &d->pictQueue[d->pictQueueBack];
+
+	// Wake up periodically to observe d->quit
+	while (SDL_SemWaitTimeout(d->pictQueueFree, 100) == SDL_MUTEX_TIMEDOUT)
 	{
-		SDL_CondWait(d->pictQueueCond, d->pictQueueMutex);
+		if (d->quit) return NULL;
 	}
-	SDL_UnlockMutex(d->pictQueueMutex);
-
-	if (d->quit) return false;
-	return true;
+	if (d->quit) return NULL;
+	return &d->pictQueue[d->pictQueueIW % d->pictQueueDepth];
 }
-void Display_pictQueue_draw(struct Display* const d)
+void Display_pictQueue_push(struct Display* const d)
 {
-	assert(d->texture);
-	struct Picture* p = &d->pictQueue[d->pictQueueIR];
-	assert(p->planeY && p->planeU && p->planeV);
-	SDL_UpdateYUVTexture(d->texture, NULL,
-	                     p->planeY, d->width,
-	                     p->planeU, d->width / 2,
-	                     p->planeV, d->width / 2);
-	SDL_RenderClear(d->renderer);
-	SDL_RenderCopy(d->renderer, d->texture, NULL, 0);
-	SDL_RenderPresent(d->renderer);
+	assert(d);
+	size_t size;
+	if (d->pictQueueMode == PICTQUEUE_LATEST)
+	{
+		size_t old = atomic_exchange(&d->pictQueueLatest,
+		                             d->pictQueueBack | DISPLAY_PICTQUEUE_NEW);
+		if (old & DISPLAY_PICTQUEUE_NEW) ++d->nFramesDropped;
+		d->pictQueueBack = old & ~DISPLAY_PICTQUEUE_NEW;
+		size = 1;
+	}
+	else
+	{
+		// The release store publishes the contents of the picture
+		size = ++d->pictQueueIW - d->pictQueueIR;
+	}
+	size_t max = d->pictQueueDepthMax;
+	while (size > max &&
+	       !atomic_compare_exchange_weak(&d->pictQueueDepthMax, &max, size));
 
-	++d->pictQueueIR;
-	if (d->pictQueueIR == DISPLAY_PICTQUEUE_SIZE_MAX)
-		d->pictQueueIR = 0;
-	SDL_LockMutex(d->pictQueueMutex);
-	--d->pictQueueSize;
-	SDL_CondSignal(d->pictQueueCond);
-	SDL_UnlockMutex(d->pictQueueMutex);
+	if (!atomic_exchange(&d->framePending, true))
+	{
+		SDL_Event event;
+		memset(&event, 0, sizeof(SDL_Event));
+		event.type = EVENT_FRAME_READY;
+		SDL_PushEvent(&event);
+	}
 }
-
-uint32_t refresh_timer(uint32_t interval, void* data)
+size_t Display_pictQueue_size(struct Display* const d)
 {
-	(void) interval;
-	SDL_Event event;
-	event.type = EVENT_REFRESH;
-	event.user.data1 = data;
-	SDL_PushEvent(&event);
-	return 0;
+	assert(d);
+	if (d->pictQueueMode == PICTQUEUE_LATEST)
+		return (d->pictQueueLatest & DISPLAY_PICTQUEUE_NEW) ? 1 : 0;
+	return d->pictQueueIW - d->pictQueueIR;
 }
-void schedule_refresh(void* data, int delay)
+bool Display_pictQueue_draw(struct Display* const d)
 {
-	if (!SDL_AddTimer(delay, refresh_timer, data))
+	struct Picture* p;
+	if (d->pictQueueMode == PICTQUEUE_LATEST)
 	{
-		fprintf(stderr, "[SDL] %s\n", SDL_GetError());
+		if (!(d->pictQueueLatest & DISPLAY_PICTQUEUE_NEW)) return false;
+		d->pictQueueFront = atomic_exchange(&d->pictQueueLatest,
+		                                    d->pictQueueFront)
+		                    & ~DISPLAY_PICTQUEUE_NEW;
+		p = &d->pictQueue[d->pictQueueFront];
+	}
+	else
+	{
+		if (d->pictQueueIW == d->pictQueueIR) return false;
+		p = &d->pictQueue[d->pictQueueIR % d->pictQueueDepth];
+	}
+
+	PROFILE_TIME(timeUpload);
+	SDL_Texture* texture = d->texture;
+	if (d->zeroCopy)
+	{
+		texture = p->texture;
+		SDL_UnlockTexture(texture);
+	}
+	else
+	{
+		assert(p->planeY && p->planeU && p->planeV);
+		SDL_UpdateYUVTexture(texture, NULL,
+		                     p->planeY, p->pitchY,
+		                     p->planeU, p->pitchUV,
+		                     p->planeV, p->pitchUV);
+	}
+	assert(texture);
+	PROFILE_RECORD(&d->profile, PROFILE_UPLOAD, timeUpload);
+	PROFILE_TIME(timePresent);
+	SDL_RenderClear(d->renderer);
+	SDL_RenderCopy(d->renderer, texture, NULL, 0);
+#ifdef SPECTROGEN_PROFILE
+	Profile_draw(&d->profile, d->renderer);
+#endif
+	SDL_RenderPresent(d->renderer);
+	PROFILE_RECORD(&d->profile, PROFILE_PRESENT, timePresent);
+	++d->nFramesDrawn;
+
+	// The picture must be mapped again before the writing thread can own it
+	if (d->zeroCopy && !Display_picture_map(d, p))
+	{
+		d->quit = true;
+		return true;
 	}
+
+	if (d->pictQueueMode == PICTQUEUE_FIFO)
+	{
+		++d->pictQueueIR;
+		SDL_SemPost(d->pictQueueFree);
+	}
+	return true;
 }
-void refresh(struct Display* const d)
+void Display_pictQueue_report(struct Display* const d)
 {
-	if (d->pictQueueSize == 0)
-		schedule_refresh(d, 1);
-	else
+	assert(d);
+	fprintf(stdout, "Frames drawn: %zu, dropped: %zu, maximum queue depth: %zu\n",
+	        (size_t) d->nFramesDrawn, (size_t) d->nFramesDropped,
+	        (size_t) d->pictQueueDepthMax);
+#ifdef SPECTROGEN_PROFILE
+	Profile_report(&d->profile);
+#endif
+}
+
+int Display_present(struct Display* const d)
+{
+	assert(d);
+	// Any picture pushed from now on posts a new event
+	d->framePending = false;
+#ifdef SPECTROGEN_PROFILE
+	Profile_update(&d->profile, d->nFramesDrawn, Display_pictQueue_size(d));
+#endif
+	if (Display_pictQueue_size(d) == 0) return -1;
+
+	uint32_t const now = SDL_GetTicks();
+	if (d->fps)
 	{
-		schedule_refresh(d, 40);
-		Display_pictQueue_draw(d);
+		uint32_t const period = 1000 / d->fps;
+		uint32_t const elapsed = now - d->lastDraw;
+		if (elapsed < period) return period - elapsed;
+		// Keep to the schedule unless a whole period has been missed
+		d->lastDraw = elapsed < 2 * period ? d->lastDraw + period : now;
 	}
+	else d->lastDraw = now;
+
+	Display_pictQueue_draw(d);
+	if (Display_pictQueue_size(d) == 0) return -1;
+	return d->fps ? (int) (1000 / d->fps) : 0;
 }
@@ -3,49 +3,140 @@
 
 #include <stdbool.h>
 
-#include <libavutil/pixfmt.h>
 #include <SDL2/SDL.h>
-#include <libswscale/swscale.h>
 
 #include "gradient.h"
+#include "layout.h"
+#include "profile.h"
 
 struct Picture
 {
 	uint8_t* planeY;
 	uint8_t* planeU;
 	uint8_t* planeV;
+	/**
+	 * Number of bytes between two adjacent rows of the planes
+	 */
+	int pitchY, pitchUV;
+	/**
+	 * Zero copy mode only. The planes point into this texture, which is locked
+	 * while the picture is owned by the writing thread.
+	 */
+	SDL_Texture* texture;
 };
 
-#define DISPLAY_PICTQUEUE_SIZE_MAX 1
-#define DISPLAY_PICTQUEUE_PIXFMT AV_PIX_FMT_YUV420P
+#define DISPLAY_PICTQUEUE_SIZE_MAX 8
+
+enum PictQueueMode
+{
+	/**
+	 * Every picture is drawn in order. The writing thread blocks while the
+	 * queue is full.
+	 */
+	PICTQUEUE_FIFO,
+	/**
+	 * Triple buffer. The writing thread never blocks and the render thread
+	 * draws the newest completed picture. Pictures replaced before being drawn
+	 * are dropped.
+	 */
+	PICTQUEUE_LATEST,
+};
 
 struct Display
 {
 	_Atomic bool quit;
 
 	struct ColourGradient colourGradient;
+	struct FrequencyLayout frequencyLayout;
 	int width;
 	int height;
 	SDL_Window* window;
 	SDL_Renderer* renderer;
 	SDL_Texture* texture;
-	struct SwsContext* swsContext;
+	/**
+	 * Set to true before Display_pictQueue_init to make the writing thread draw
+	 * into locked texture memory, avoiding a copy per frame.
+	 *
+	 * The render thread locks the texture of each picture before handing it to
+	 * the writing thread, and unlocks it once the picture is written.
+	 * SDL_LockTexture and SDL_UnlockTexture are only called from the render
+	 * thread.
+	 */
+	bool zeroCopy;
+	/**
+	 * Set before Display_pictQueue_init to synchronise presentation with the
+	 * refresh of the display.
+	 */
+	bool vsync;
+	/**
+	 * Maximum number of pictures drawn per second. 0 draws every picture as
+	 * soon as it is ready.
+	 */
+	unsigned fps;
+	/**
+	 * Render thread only. Time of the last draw in SDL_GetTicks.
+	 */
+	uint32_t lastDraw;
+	/**
+	 * Set by the writing thread when EVENT_FRAME_READY has been pushed and not
+	 * yet handled by Display_present
+	 */
+	_Atomic bool framePending;
 
+	/*
+	 * The pictQueue is a single producer, single consumer queue between the
+	 * writing thread and the render thread. Set pictQueueMode and
+	 * pictQueueDepth before Display_pictQueue_init.
+	 */
 	struct Picture pictQueue[DISPLAY_PICTQUEUE_SIZE_MAX];
+	enum PictQueueMode pictQueueMode;
+	/**
+	 * Number of pictures in PICTQUEUE_FIFO, between 1 and
+	 * DISPLAY_PICTQUEUE_SIZE_MAX. PICTQUEUE_LATEST always uses 3.
+	 */
+	size_t pictQueueDepth;
 	/*
+	 * PICTQUEUE_FIFO: Number of pictures drawn and written.
 	 * pictQueueIR can only be modified by the render thread
 	 * pictQueueIW can only be modified by the writing thread
 	 */
-	size_t pictQueueSize, pictQueueIR, pictQueueIW;
-	SDL_mutex* pictQueueMutex;
-	SDL_cond* pictQueueCond;
+	_Atomic size_t pictQueueIR, pictQueueIW;
+	/**
+	 * PICTQUEUE_FIFO: Counts the free pictures
+	 */
+	SDL_sem* pictQueueFree;
+	/*
+	 * PICTQUEUE_LATEST: pictQueueBack is owned by the writing thread and
+	 * pictQueueFront by the render thread. pictQueueLatest holds the third
+	 * picture, flagged with DISPLAY_PICTQUEUE_NEW if it has not been drawn.
+	 */
+	size_t pictQueueBack, pictQueueFront;
+	_Atomic size_t pictQueueLatest;
+
+	// Statistics
+	_Atomic size_t nFramesDrawn, nFramesDropped;
+	/**
+	 * Highest number of pictures waiting to be drawn
+	 */
+	_Atomic size_t pictQueueDepthMax;
+#ifdef SPECTROGEN_PROFILE
+	/**
+	 * Initialised by Display_init. Updated and drawn by Display_present.
+	 */
+	struct Profile profile;
+#endif
 };
 
+#define DISPLAY_PICTQUEUE_NEW ((size_t) 1 << (sizeof(size_t) * 8 - 1))
+
 void Display_init(struct Display* const);
 void Display_destroy(struct Display* const);
 /**
  * Render thread only
  * @brief Initialises the pictQueue and renderer.
+ * @return false if the renderer or a texture cannot be created or mapped.
+ *  What was created is destroyed then, and Display_pictQueue_destroy does
+ *  nothing.
  */
 bool Display_pictQueue_init(struct Display* const);
 /**
@@ -54,18 +145,41 @@ bool Display_pictQueue_init(struct Display* const);
  */
 void Display_pictQueue_destroy(struct Display* const);
 /**
- * @brief Blocks the current thread until the writing position is available.
- * @return false if d->quit is set to true
+ * @brief Blocks the current thread until a picture is available for writing.
+ * @return The picture, or NULL if d->quit is set to true
+ */
+struct Picture* Display_pictQueue_write(struct Display* const);
+/**
+ * @brief Hands the picture returned by Display_pictQueue_write, which has been
+ *  written, to the render thread.
  */
-bool Display_pictQueue_write(struct Display* const);
+void Display_pictQueue_push(struct Display* const);
+/**
+ * @brief Number of pictures waiting to be drawn
+ */
+size_t Display_pictQueue_size(struct Display* const);
 /**
  * Render thread only
  * @brief Draws the current picture onto the renderer
+ * @return false if there is no picture to draw
+ */
+bool Display_pictQueue_draw(struct Display* const);
+/**
+ * @brief Prints the numbers of frames drawn and dropped, and the time spent in
+ *  each stage in SPECTROGEN_PROFILE builds
  */
-void Display_pictQueue_draw(struct Display* const);
+void Display_pictQueue_report(struct Display* const);
 
-#define EVENT_REFRESH (SDL_USEREVENT + 2)
+/**
+ * Pushed by Display_pictQueue_push to wake up the render thread
+ */
+#define EVENT_FRAME_READY (SDL_USEREVENT + 2)
 
-void schedule_refresh(void* data, int delay);
-void refresh(struct Display* const d);
+/**
+ * Render thread only
+ * @brief Draws the next picture if one is ready and d->fps allows.
+ * @return Milliseconds until the next picture is due, or -1 if there is no
+ *  picture waiting. Suitable as the timeout of SDL_WaitEventTimeout.
+ */
+int Display_present(struct Display* const);
 #endif // !SPECTROGEN__DISPLAY_H_
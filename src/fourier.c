@@ -2,9 +2,14 @@
 
 #include <assert.h>
 #include <math.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
+#include <unistd.h>
+
+#include "simd.h"
+
 void window_rect(real* const window, size_t n)
 {
 	window[0] = 1.0 / n;
@@ -37,20 +42,93 @@ void window_exponential_causal(real* const window, size_t n, real var)
 {
 	size_t radius = n / 2;
 	real a = var / n;
+	memset(window, 0, sizeof(real) * n);
 	for (size_t i = 0; i < radius; ++i)
 	{
 		window[i + radius] = a * exp(-(i * a));
 	}
-	memset(window, 0, radius);
+}
+void window_populate(real* const window, size_t n,
+                     enum WindowFunction type, real var)
+{
+	switch (type)
+	{
+	case WINDOW_RECT:
+		window_rect(window, n);
+		break;
+	case WINDOW_TRI:
+		window_tri(window, n);
+		break;
+	case WINDOW_GAUSSIAN:
+		window_gaussian(window, n, var);
+		break;
+	case WINDOW_EXPCAUSAL:
+		window_exponential_causal(window, n, var);
+		break;
+	}
 }
 void convolve(real* samples, real const* window, size_t n)
 {
-	window += n;
-	for (size_t i = 0; i < n; ++i)
+	simd_window(samples, samples, window, n);
+}
+
+/**
+ * @brief Identifies the processor, whose model and features decide which
+ *  plans are fastest
+ */
+static unsigned long dstft_cpu_key(void)
+{
+	// FNV-1a of the model name and flags of the first processor
+	unsigned long hash = 2166136261ul;
+	FILE* const cpuinfo = fopen("/proc/cpuinfo", "r");
+	if (!cpuinfo) return hash;
+	char line[4096];
+	int nFields = 0;
+	while (nFields < 2 && fgets(line, sizeof(line), cpuinfo))
+	{
+		if (strncmp(line, "model name", 10) != 0 &&
+		    strncmp(line, "flags", 5) != 0)
+			continue;
+		for (char const* c = line; *c; ++c)
+			hash = ((hash ^ (unsigned char) *c) * 16777619ul) & 0xFFFFFFFFul;
+		++nFields;
+	}
+	fclose(cpuinfo);
+	return hash;
+}
+bool DSTFT_wisdom_path(struct DSTFT const* const d, char* const path, size_t size)
+{
+	assert(d && d->wisdomDir);
+#ifdef SPECTROGEN_SINGLE_PRECISION
+	char const* const precision = "float";
+#else
+	char const* const precision = "double";
+#endif
+	int const n = snprintf(path, size, "%s/%s-%08lx-%zu-%zu.wisdom",
+	                       d->wisdomDir, precision, dstft_cpu_key(),
+	                       d->windowWidth, d->batchSize ? d->batchSize : 1);
+	return n >= 0 && (size_t) n < size;
+}
+/**
+ * @brief Replaces the wisdom file at path with the current wisdom. The file is
+ *  renamed into place so concurrent readers never see it partially written.
+ */
+static void DSTFT_wisdom_save(char const* const path)
+{
+	// A unique name, so processes sharing the directory do not collide
+	char temp[strlen(path) + sizeof(".XXXXXX")];
+	snprintf(temp, sizeof(temp), "%s.XXXXXX", path);
+	int const fd = mkstemp(temp);
+	if (fd < 0)
+	{
+		fprintf(stderr, "Unable to save wisdom to %s\n", path);
+		return;
+	}
+	close(fd);
+	if (!FFTW(export_wisdom_to_filename)(temp) || rename(temp, path) != 0)
 	{
-		--window;
-		*samples *= *window;
-		++samples;
+		fprintf(stderr, "Unable to save wisdom to %s\n", path);
+		remove(temp);
 	}
 }
 
@@ -58,19 +136,84 @@ void DSTFT_init(struct DSTFT* const d)
 {
 	assert(d);
 	assert(d->windowWidth);
+	if (d->batchSize == 0) d->batchSize = 1;
+	unsigned const rigor = d->planRigor ? d->planRigor : FFTW_MEASURE;
+	char path[4096];
+	bool const wisdom = d->wisdomDir &&
+	                    DSTFT_wisdom_path(d, path, sizeof(path));
+	char* known = NULL;
+	if (wisdom)
+	{
+		/*
+		 * The wisdom of the process is kept, since a host application may
+		 * have its own. The file is merged into it.
+		 */
+		FFTW(import_wisdom_from_filename)(path);
+		known = FFTW(export_wisdom_to_string)();
+	}
+
 	d->windowRadius = d->windowWidth / 2;
 	d->window = malloc(sizeof(real) * d->windowWidth);
-	d->buffer = fftw_malloc(sizeof(real) * d->windowWidth);
-	d->spectrum = fftw_malloc(sizeof(comp) * (d->windowRadius + 1));
-	d->plan = fftw_plan_dft_r2c_1d(d->windowWidth, d->buffer, d->spectrum,
-	                               FFTW_MEASURE);
-	memset(d->buffer, 0, sizeof(real) * d->windowWidth);
+	d->buffer = FFTW(malloc)(sizeof(real) * d->windowWidth * d->batchSize);
+	d->spectrum = FFTW(malloc)(sizeof(comp) * (d->windowRadius + 1) *
+	                          d->batchSize);
+	d->power = malloc(sizeof(real) * (d->windowRadius + 1));
+	d->plan = FFTW(plan_dft_r2c_1d)(d->windowWidth, d->buffer, d->spectrum,
+	                                rigor);
+	if (d->batchSize > 1)
+	{
+		int n = d->windowWidth;
+		d->planBatch = FFTW(plan_many_dft_r2c)(1, &n, d->batchSize,
+		                                       d->buffer, NULL,
+		                                       1, d->windowWidth,
+		                                       d->spectrum, NULL,
+		                                       1, d->windowRadius + 1,
+		                                       rigor);
+	}
+	else
+		d->planBatch = NULL;
+	d->shared = false;
+	if (wisdom)
+	{
+		// Only rewrite the file if planning found something new
+		char* const learnt = FFTW(export_wisdom_to_string)();
+		if (!known || !learnt || strcmp(known, learnt) != 0)
+			DSTFT_wisdom_save(path);
+		FFTW(free)(known);
+		FFTW(free)(learnt);
+	}
+	memset(d->buffer, 0, sizeof(real) * d->windowWidth * d->batchSize);
+}
+void DSTFT_init_copy(struct DSTFT* const d, struct DSTFT const* const source)
+{
+	assert(d && source);
+	assert(source->window);
+	memset(d, 0, sizeof(struct DSTFT));
+	d->windowWidth = source->windowWidth;
+	d->batchSize = source->batchSize;
+	d->windowRadius = source->windowRadius;
+	d->window = source->window;
+	/*
+	 * fftw_malloc gives every buffer the same alignment, which the new-array
+	 * execution requires.
+	 */
+	d->buffer = FFTW(malloc)(sizeof(real) * d->windowWidth * d->batchSize);
+	d->spectrum = FFTW(malloc)(sizeof(comp) * (d->windowRadius + 1) *
+	                          d->batchSize);
+	d->power = malloc(sizeof(real) * (d->windowRadius + 1));
+	d->plan = source->plan;
+	d->planBatch = source->planBatch;
+	d->shared = true;
+	memset(d->buffer, 0, sizeof(real) * d->windowWidth * d->batchSize);
 }
 void DSTFT_destroy(struct DSTFT* const d)
 {
 	if (!d) return;
+	FFTW(free)(d->buffer);
+	FFTW(free)(d->spectrum);
+	free(d->power);
+	if (d->shared) return;
 	free(d->window);
-	fftw_free(d->buffer);
-	fftw_free(d->spectrum);
-	fftw_destroy_plan(d->plan);
+	FFTW(destroy_plan)(d->plan);
+	if (d->planBatch) FFTW(destroy_plan)(d->planBatch);
 }
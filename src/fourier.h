@@ -2,14 +2,33 @@
 #define SPECTROGEN__FOURIER_H_
 
 #include <complex.h>
+#include <stdbool.h>
 #include <stddef.h>
 
 #include <fftw3.h>
 
 #include "spectrogen.h"
+#include "workerpool.h"
+
+/**
+ * FFTW(name) refers to the FFTW routine or type matching the precision of real
+ */
+#ifdef SPECTROGEN_SINGLE_PRECISION
+#define FFTW(name) fftwf_ ## name
+#else
+#define FFTW(name) fftw_ ## name
+#endif
 
 // All window functions result in a window with energy 1
 
+enum WindowFunction
+{
+	WINDOW_RECT,
+	WINDOW_TRI,
+	WINDOW_GAUSSIAN,
+	WINDOW_EXPCAUSAL
+};
+
 void window_rect(real* const, size_t n);
 void window_tri(real* const, size_t n);
 /**
@@ -21,6 +40,12 @@ void window_tri(real* const, size_t n);
 void window_gaussian(real* const window, size_t n, real var);
 
 void window_exponential_causal(real* const window, size_t n, real var);
+/**
+ * @brief Fills the window with the window function type
+ * @param[in] var Ignored for WINDOW_RECT and WINDOW_TRI
+ */
+void window_populate(real* const window, size_t n,
+                     enum WindowFunction type, real var);
 /**
  * @brief Convolves the window with sample. Result will be stored in samples
  */
@@ -29,19 +54,78 @@ void convolve(real* samples, real const* window, size_t n);
 struct DSTFT
 {
 	size_t windowWidth;
+	/**
+	 * Number of frames transformed together by planBatch. 0 is treated as 1.
+	 */
+	size_t batchSize;
+	/**
+	 * If not NULL, the plans are loaded from and saved to a wisdom file in
+	 * this directory, keyed by windowWidth, batchSize, precision and CPU. See
+	 * DSTFT_wisdom_path. The file is merged into the global FFTW wisdom of the
+	 * process, and when planning learns something new, all of that wisdom is
+	 * saved to it, including plans of other sizes.
+	 */
+	char const* wisdomDir;
+	/**
+	 * FFTW planning rigor, e.g. FFTW_PATIENT. 0 is treated as FFTW_MEASURE.
+	 * Wisdom of a higher rigor satisfies a lower one.
+	 */
+	unsigned planRigor;
+	/**
+	 * Threads sharing the columns between an array of workspaces. Set on the
+	 * first workspace of the array by its owner, and not copied by
+	 * DSTFT_init_copy. If NULL, every share runs on the calling thread.
+	 */
+	struct WorkerPool* pool;
 
 	// Populated by DSTFT_init
 	size_t windowRadius;
 	real* window;
+	/**
+	 * batchSize contiguous frames of windowWidth reals
+	 */
 	real* buffer;
+	/**
+	 * batchSize contiguous spectra of (windowRadius + 1) components
+	 */
 	comp* spectrum;
-	fftw_plan plan;
+	/**
+	 * Scratch space for the squared magnitudes of one spectrum
+	 */
+	real* power;
+	/**
+	 * Transforms the first frame of buffer into the first spectrum
+	 */
+	FFTW(plan) plan;
+	/**
+	 * Transforms all frames of buffer at once. NULL if batchSize is 1.
+	 */
+	FFTW(plan) planBatch;
+	/**
+	 * True if window and the plans belong to another workspace. The plans are
+	 * then executed on buffer and spectrum with the new-array interface.
+	 */
+	bool shared;
 };
 		
 /**
- * Must be called after windowWidth is initialised
+ * Must be called after windowWidth, batchSize, wisdomDir and planRigor are
+ * initialised
  */
 void DSTFT_init(struct DSTFT* const);
+/**
+ * @brief Path of the wisdom file of the workspace in wisdomDir
+ * @return false if the path does not fit in size characters
+ */
+bool DSTFT_wisdom_path(struct DSTFT const* const, char* const path, size_t size);
+/**
+ * Only the buffers are allocated. The window and the plans of source are
+ * shared, so source must outlive the copy and nothing is planned. Executing a
+ * plan is thread-safe, so the workspaces can be used concurrently.
+ * @brief Initialises a workspace with the same window width, batch size and
+ *  window function as source, so both produce identical spectra.
+ */
+void DSTFT_init_copy(struct DSTFT* const, struct DSTFT const* const source);
 void DSTFT_destroy(struct DSTFT* const);
 
 #endif // !SPECTROGEN__FOURIER_H_
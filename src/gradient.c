@@ -85,8 +85,8 @@ real Gradient_eval(struct Gradient const* const g, real x)
 	size_t i = 0;
 	size_t const n = g->nPoints;
 	assert(n != 0);
-	while (g->x[i] < x && i < n) ++i;
-	if (x < g->x[0] || i == n) // Terminal behaviour
+	while (i < n && g->x[i] < x) ++i;
+	if (i == 0 || i == n) // Terminal behaviour
 	{
 		if (g->terminal == INTERP_NEAREST)
 		{
@@ -140,6 +140,8 @@ void ColourGradient_init(struct ColourGradient* const g, size_t nPoints)
 	Gradient_init(&g->g, nPoints);
 	Gradient_init(&g->b, nPoints);
 	g->r.terminal = g->g.terminal = g->b.terminal = INTERP_NEAREST;
+	g->lut = NULL;
+	g->lutYUV = NULL;
 }
 void ColourGradient_destroy(struct ColourGradient* const g)
 {
@@ -147,6 +149,28 @@ void ColourGradient_destroy(struct ColourGradient* const g)
 	Gradient_destroy(&g->r);
 	Gradient_destroy(&g->g);
 	Gradient_destroy(&g->b);
+	free(g->lut);
+	free(g->lutYUV);
+}
+uint8_t real_to_colour(real val)
+{
+	if (val < 0.0) return 0;
+	else if (val > 255.0) return 255;
+	else return (uint8_t) val;
+}
+static void rgb_to_yuv(uint8_t const rgb[3], uint8_t yuv[3])
+{
+	real r = rgb[0], g = rgb[1], b = rgb[2];
+	yuv[0] = real_to_colour(16.5 + (65.481 * r + 128.553 * g + 24.966 * b) / 255);
+	yuv[1] = real_to_colour(128.5 + (-37.797 * r - 74.203 * g + 112.0 * b) / 255);
+	yuv[2] = real_to_colour(128.5 + (112.0 * r - 93.786 * g - 18.214 * b) / 255);
+}
+static void ColourGradient_eval_spline(struct ColourGradient const* const g,
+                                       real x, uint8_t colour[3])
+{
+	colour[0] = real_to_colour(Gradient_eval(&g->r, x));
+	colour[1] = real_to_colour(Gradient_eval(&g->g, x));
+	colour[2] = real_to_colour(Gradient_eval(&g->b, x));
 }
 void ColourGradient_populate(struct ColourGradient* const g)
 {
@@ -154,19 +178,121 @@ void ColourGradient_populate(struct ColourGradient* const g)
 	Gradient_populate(&g->r);
 	Gradient_populate(&g->g);
 	Gradient_populate(&g->b);
+
+	free(g->lut);
+	free(g->lutYUV);
+	g->lut = NULL;
+	g->lutYUV = NULL;
+	if (g->r.terminal != INTERP_NEAREST || g->g.terminal != INTERP_NEAREST ||
+	    g->b.terminal != INTERP_NEAREST)
+		return;
+
+	struct Gradient const* const channels[3] = { &g->r, &g->g, &g->b };
+	real min = channels[0]->x[0];
+	real max = channels[0]->x[channels[0]->nPoints - 1];
+	for (size_t i = 1; i < 3; ++i)
+	{
+		if (channels[i]->x[0] < min)
+			min = channels[i]->x[0];
+		if (channels[i]->x[channels[i]->nPoints - 1] > max)
+			max = channels[i]->x[channels[i]->nPoints - 1];
+	}
+	if (!(max > min)) return;
+
+	g->lut = malloc(3 * COLOURGRADIENT_LUT_SIZE);
+	g->lutYUV = malloc(3 * COLOURGRADIENT_LUT_SIZE);
+	g->lutMin = min;
+	g->lutScale = (COLOURGRADIENT_LUT_SIZE - 1) / (max - min);
+	for (size_t i = 0; i < COLOURGRADIENT_LUT_SIZE; ++i)
+	{
+		ColourGradient_eval_spline(g, min + i / g->lutScale, g->lut + 3 * i);
+		rgb_to_yuv(g->lut + 3 * i, g->lutYUV + 3 * i);
+	}
 }
-uint8_t real_to_colour(real val)
+/**
+ * @brief Index of the entry of the lookup table nearest to x
+ */
+static size_t ColourGradient_index(struct ColourGradient const* const g,
+                                   real x)
 {
-	if (val < 0.0) return 0;
-	else if (val > 255.0) return 255;
-	else return (uint8_t) val;
+	real t = (x - g->lutMin) * g->lutScale;
+	size_t i;
+	if (!(t > 0)) // Includes NaN
+		i = 0;
+	else if (t >= COLOURGRADIENT_LUT_SIZE - 1)
+		i = COLOURGRADIENT_LUT_SIZE - 1;
+	else
+		i = (size_t) (t + 0.5);
+	return i;
 }
 void ColourGradient_eval(struct ColourGradient const* const g,
                          real x, uint8_t colour[3])
 {
 	assert(g);
 	assert(colour);
-	colour[0] = real_to_colour(Gradient_eval(&g->r, x));
-	colour[1] = real_to_colour(Gradient_eval(&g->g, x));
-	colour[2] = real_to_colour(Gradient_eval(&g->b, x));
+	if (!g->lut)
+	{
+		ColourGradient_eval_spline(g, x, colour);
+		return;
+	}
+	uint8_t const* const c = g->lut + 3 * ColourGradient_index(g, x);
+	colour[0] = c[0];
+	colour[1] = c[1];
+	colour[2] = c[2];
+}
+void ColourGradient_eval_yuv(struct ColourGradient const* const g,
+                             real x, uint8_t colour[3])
+{
+	assert(g);
+	assert(colour);
+	if (!g->lutYUV)
+	{
+		uint8_t rgb[3];
+		ColourGradient_eval_spline(g, x, rgb);
+		rgb_to_yuv(rgb, colour);
+		return;
+	}
+	uint8_t const* const c = g->lutYUV + 3 * ColourGradient_index(g, x);
+	colour[0] = c[0];
+	colour[1] = c[1];
+	colour[2] = c[2];
+}
+void ColourGradient_init_preset(struct ColourGradient* const grad)
+{
+	assert(grad);
+	size_t nPoints = 9;
+	ColourGradient_init(grad, nPoints);
+	grad->r.interpolation = grad->g.interpolation = grad->b.interpolation
+		= INTERP_SPLINE3;
+
+	real* const r = grad->r.y;
+	real* const g = grad->g.y;
+	real* const b = grad->b.y;
+
+	real* const x = grad->r.x;
+
+#define COLOUR_SET(index, t, red, green, blue) \
+	x[index] = t; \
+	r[index] = red; g[index] = green; b[index] = blue;
+
+	COLOUR_SET(0, -12, 0.0, 0.0, 0.0);
+	COLOUR_SET(1, -7.2, 31, 0, 0);
+	COLOUR_SET(2, -6.5, 61, 13, 2);
+	COLOUR_SET(3, -5.5, 204, 34, 22);
+	COLOUR_SET(4, -4, 238, 191, 40);
+	COLOUR_SET(5, -3, 32, 194, 111);
+	COLOUR_SET(6, -2, 37, 105, 245);
+	COLOUR_SET(7, -1, 200, 170, 255);
+	COLOUR_SET(8, 0, 255, 255, 255);
+
+	for (size_t i = 0; i < nPoints; ++i)
+	{
+		real fac = 2.0 / (3.0 - i / (real) nPoints);
+		r[i] *= fac;
+		g[i] *= fac;
+		b[i] *= fac;
+	}
+	memcpy(grad->g.x, x, sizeof(real) * nPoints);
+	memcpy(grad->b.x, x, sizeof(real) * nPoints);
+	ColourGradient_populate(grad);
 }
@@ -37,16 +37,54 @@ void Gradient_destroy(struct Gradient* const);
 void Gradient_populate(struct Gradient* const);
 real Gradient_eval(struct Gradient const* const, real x);
 
+#define COLOURGRADIENT_LUT_SIZE 4096
+
 struct ColourGradient
 {
 	struct Gradient r;
 	struct Gradient g;
 	struct Gradient b;
+
+	// Populated by ColourGradient_populate
+	/**
+	 * COLOURGRADIENT_LUT_SIZE colours in the RGB888 format, sampled evenly over
+	 * the domain of the control points. NULL if a terminal behaviour is not
+	 * INTERP_NEAREST, since the colours outside the domain are then not
+	 * constant.
+	 */
+	uint8_t* lut;
+	/**
+	 * The colours of lut converted to BT.601 limited range YUV
+	 */
+	uint8_t* lutYUV;
+	real lutMin;
+	/**
+	 * Number of entries per unit of x
+	 */
+	real lutScale;
 };
 void ColourGradient_init(struct ColourGradient* const, size_t nPoints);
 void ColourGradient_destroy(struct ColourGradient* const);
+/**
+ * @brief Initialises and populates the default gradient of Spectrogen, from
+ *  black at -12 to white at 0
+ */
+void ColourGradient_init_preset(struct ColourGradient* const);
+/**
+ * @brief Populates the gradients and bakes the colour lookup table
+ */
 void ColourGradient_populate(struct ColourGradient* const);
+/**
+ * @brief Evaluates the colour at x from the lookup table if it exists. NaN is
+ *  treated as -infinity.
+ */
 void ColourGradient_eval(struct ColourGradient const* const,
                          real x, uint8_t colour[3]);
+/**
+ * @brief Same as ColourGradient_eval, but the colour is in BT.601 limited
+ *  range YUV, as uploaded to the YV12 textures of the display.
+ */
+void ColourGradient_eval_yuv(struct ColourGradient const* const,
+                             real x, uint8_t colour[3]);
 
 #endif // !SPECTROGEN__GRADIENT_H_
@@ -0,0 +1,67 @@
+#include "headless.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "imagefile.h"
+
+/**
+ * @brief Writes the amplitudes as 32 bit floats in native byte order
+ */
+static bool headless_write_amplitudes(char const* const outputName,
+                                      real const* const amplitudes, size_t n)
+{
+	FILE* const file = fopen(outputName, "wb");
+	if (!file)
+	{
+		perror(outputName);
+		return false;
+	}
+	for (size_t i = 0; i < n; ++i)
+	{
+		float const value = amplitudes[i];
+		fwrite(&value, sizeof(float), 1, file);
+	}
+	bool const success = !ferror(file);
+	if (fclose(file) != 0 || !success)
+	{
+		perror(outputName);
+		return false;
+	}
+	return true;
+}
+
+bool headless_exec(struct Spectrogen* const s,
+                   char const* const fileName, enum SampleFileType fileType,
+                   char const* const outputName, bool amplitudes)
+{
+	struct SampleSource source;
+	if (!SampleSource_open(&source, fileName, fileType, &s->pool))
+		return false;
+
+	clock_t timeStart = clock();
+	size_t const n = (size_t) s->width * s->height;
+	bool success;
+	if (amplitudes)
+	{
+		real* const values = malloc(sizeof(real) * n);
+		success = Spectrogen_amplitudes(s, &source, values) &&
+		          headless_write_amplitudes(outputName, values, n);
+		free(values);
+	}
+	else
+	{
+		uint8_t* const rgb = malloc(3 * n);
+		success = Spectrogen_render(s, &source, rgb) &&
+		          image_write(outputName, image_file_type(outputName),
+		                      rgb, s->width, s->height);
+		free(rgb);
+	}
+	SampleSource_close(&source);
+
+	clock_t timeDiff = (clock() - timeStart) * 1000 / CLOCKS_PER_SEC;
+	if (success)
+		fprintf(stdout, "%s: %ld ms\n", outputName, timeDiff);
+	return success;
+}
@@ -0,0 +1,23 @@
+#ifndef SPECTROGEN__HEADLESS_H_
+#define SPECTROGEN__HEADLESS_H_
+
+#include <stdbool.h>
+
+#include "libspectrogen.h"
+#include "samplesource.h"
+
+/**
+ * @brief Renders the spectrogram of a sample file into outputName without a
+ *  display
+ * @param[in] fileName A file containing samples in a format of enum
+ *  SampleFileType
+ * @param[in] outputName The format is taken from the extension, see
+ *  image_file_type
+ * @param amplitudes If true, the log amplitudes are written as raw 32 bit
+ *  floats, row by row, instead of an image
+ */
+bool headless_exec(struct Spectrogen* const,
+                   char const* const fileName, enum SampleFileType fileType,
+                   char const* const outputName, bool amplitudes);
+
+#endif // !SPECTROGEN__HEADLESS_H_
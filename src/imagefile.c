@@ -0,0 +1,161 @@
+#include "imagefile.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Largest stored (uncompressed) deflate block
+ */
+#define PNG_BLOCK_SIZE 65535
+
+enum ImageFileType image_file_type(char const* const fileName)
+{
+	char const* const extension = strrchr(fileName, '.');
+	if (!extension) return IMAGEFILE_RAW;
+	if (strcmp(extension, ".ppm") == 0) return IMAGEFILE_PPM;
+	if (strcmp(extension, ".png") == 0) return IMAGEFILE_PNG;
+	return IMAGEFILE_RAW;
+}
+
+static uint32_t png_crc_table[256];
+static void png_crc_init(void)
+{
+	for (uint32_t n = 0; n < 256; ++n)
+	{
+		uint32_t c = n;
+		for (int k = 0; k < 8; ++k)
+			c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+		png_crc_table[n] = c;
+	}
+}
+/**
+ * @brief Writes n bytes of a chunk, updating its CRC
+ */
+static void png_put(FILE* const file, uint32_t* const crc,
+                    uint8_t const* const data, size_t n)
+{
+	uint32_t c = *crc;
+	for (size_t i = 0; i < n; ++i)
+		c = png_crc_table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+	*crc = c;
+	fwrite(data, 1, n, file);
+}
+static void png_put_u32(FILE* const file, uint32_t* const crc, uint32_t value)
+{
+	uint8_t const bytes[4] =
+	{
+		value >> 24, (value >> 16) & 0xFF, (value >> 8) & 0xFF, value & 0xFF
+	};
+	png_put(file, crc, bytes, 4);
+}
+/**
+ * @brief Writes the length and type of a chunk, and starts its CRC
+ */
+static void png_chunk_begin(FILE* const file, uint32_t* const crc,
+                            char const type[4], uint32_t length)
+{
+	uint32_t dummy;
+	png_put_u32(file, &dummy, length);
+	*crc = 0xFFFFFFFFu;
+	png_put(file, crc, (uint8_t const*) type, 4);
+}
+static void png_chunk_end(FILE* const file, uint32_t crc)
+{
+	uint32_t dummy;
+	png_put_u32(file, &dummy, crc ^ 0xFFFFFFFFu);
+}
+/**
+ * Truecolour PNG whose image data is a zlib stream of stored deflate blocks,
+ * which needs no compression library
+ */
+static void image_write_png(FILE* const file, uint8_t const* const rgb,
+                            int width, int height)
+{
+	png_crc_init();
+	static uint8_t const signature[8] =
+	{
+		0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'
+	};
+	fwrite(signature, 1, 8, file);
+
+	uint32_t crc;
+	png_chunk_begin(file, &crc, "IHDR", 13);
+	png_put_u32(file, &crc, width);
+	png_put_u32(file, &crc, height);
+	// 8 bit truecolour, deflate, adaptive filtering, no interlace
+	uint8_t const header[5] = { 8, 2, 0, 0, 0 };
+	png_put(file, &crc, header, 5);
+	png_chunk_end(file, crc);
+
+	// Each row is preceded by filter type 0
+	size_t const rowSize = 3 * (size_t) width + 1;
+	size_t const size = rowSize * height;
+	uint8_t* const data = malloc(size);
+	for (int row = 0; row < height; ++row)
+	{
+		data[row * rowSize] = 0;
+		memcpy(data + row * rowSize + 1, rgb + row * (rowSize - 1),
+		       rowSize - 1);
+	}
+	size_t const nBlocks = (size + PNG_BLOCK_SIZE - 1) / PNG_BLOCK_SIZE;
+	png_chunk_begin(file, &crc, "IDAT", 2 + 5 * nBlocks + size + 4);
+	uint8_t const zlibHeader[2] = { 0x78, 0x01 };
+	png_put(file, &crc, zlibHeader, 2);
+	uint32_t adlerA = 1, adlerB = 0;
+	for (size_t begin = 0; begin < size; begin += PNG_BLOCK_SIZE)
+	{
+		size_t n = size - begin;
+		if (n > PNG_BLOCK_SIZE) n = PNG_BLOCK_SIZE;
+		uint8_t const block[5] =
+		{
+			begin + n == size, n & 0xFF, n >> 8, ~n & 0xFF, (~n >> 8) & 0xFF
+		};
+		png_put(file, &crc, block, 5);
+		png_put(file, &crc, data + begin, n);
+		for (size_t i = begin; i < begin + n; ++i)
+		{
+			adlerA = (adlerA + data[i]) % 65521;
+			adlerB = (adlerB + adlerA) % 65521;
+		}
+	}
+	png_put_u32(file, &crc, (adlerB << 16) | adlerA);
+	png_chunk_end(file, crc);
+	free(data);
+
+	png_chunk_begin(file, &crc, "IEND", 0);
+	png_chunk_end(file, crc);
+}
+
+bool image_write(char const* const fileName, enum ImageFileType type,
+                 uint8_t const* const rgb, int width, int height)
+{
+	assert(width > 0 && height > 0);
+	FILE* const file = fopen(fileName, "wb");
+	if (!file)
+	{
+		perror(fileName);
+		return false;
+	}
+	switch (type)
+	{
+	case IMAGEFILE_PPM:
+		fprintf(file, "P6\n%d %d\n255\n", width, height);
+		fwrite(rgb, 3, (size_t) width * height, file);
+		break;
+	case IMAGEFILE_PNG:
+		image_write_png(file, rgb, width, height);
+		break;
+	case IMAGEFILE_RAW:
+		fwrite(rgb, 3, (size_t) width * height, file);
+		break;
+	}
+	bool const success = !ferror(file);
+	if (fclose(file) != 0 || !success)
+	{
+		perror(fileName);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,26 @@
+#ifndef SPECTROGEN__IMAGEFILE_H_
+#define SPECTROGEN__IMAGEFILE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum ImageFileType
+{
+	IMAGEFILE_PPM, // Binary portable pixmap (P6)
+	IMAGEFILE_PNG, // Uncompressed truecolour PNG
+	IMAGEFILE_RAW // RGB888, row by row, without a header
+};
+
+/**
+ * @brief Guesses the type from the extension of fileName. Unknown extensions
+ *  are raw.
+ */
+enum ImageFileType image_file_type(char const* const fileName);
+/**
+ * @param[in] rgb An array of size width * height * 3 in the RGB888 format
+ * @return false if the file cannot be written. The error is printed to stderr.
+ */
+bool image_write(char const* const fileName, enum ImageFileType,
+                 uint8_t const* const rgb, int width, int height);
+
+#endif // !SPECTROGEN__IMAGEFILE_H_
@@ -0,0 +1,93 @@
+#include "layout.h"
+
+#include <assert.h>
+#include <tgmath.h>
+#include <stdlib.h>
+
+#include "simd.h"
+
+real FrequencyLayout_component(struct FrequencyLayout const* const l, real y)
+{
+	real const t = l->low + y * (l->high - l->low);
+	/*
+	 * A map casts [0, 1] to [1, windowRadius]. The +1 avoids the constant
+	 * term.
+	 */
+	if (l->axis == AXIS_LINEAR)
+		return t * l->windowRadius + 1;
+	return (pow(2, t) - 1) * l->windowRadius + 1;
+}
+/**
+ * @brief Highest component shown in a row whose top lies at t of the height
+ */
+static size_t layout_bin(struct FrequencyLayout const* const l, real t)
+{
+	size_t const j = FrequencyLayout_component(l, t);
+	return j > l->windowRadius ? l->windowRadius : j;
+}
+
+void FrequencyLayout_init(struct FrequencyLayout* const l)
+{
+	assert(l);
+	assert(l->height > 0);
+	assert(l->windowRadius >= 1);
+	l->binBegin = malloc(sizeof(size_t) * l->height);
+	l->binEnd = malloc(sizeof(size_t) * l->height);
+	l->constantQ = NULL;
+	FrequencyLayout_zoom(l, 0, 1);
+}
+void FrequencyLayout_zoom(struct FrequencyLayout* const l, real low, real high)
+{
+	assert(l && l->binBegin);
+	assert(0 <= low && low < high && high <= 1);
+	l->low = low;
+	l->high = high;
+
+	// (height - row) flips the spectrogram upside down
+	size_t below = layout_bin(l, 0) - 1;
+	for (int row = l->height - 1; row >= 0; --row)
+	{
+		size_t top = layout_bin(l, (l->height - row) / (real) l->height);
+		l->binEnd[row] = top + 1;
+		l->binBegin[row] = below < top ? below + 1 : top;
+		below = top;
+	}
+}
+void FrequencyLayout_destroy(struct FrequencyLayout* const l)
+{
+	if (!l) return;
+	free(l->binBegin);
+	free(l->binEnd);
+}
+void FrequencyLayout_eval(struct FrequencyLayout const* const l,
+                          real* const amplitudes, real const* const power)
+{
+	assert(l && l->binBegin);
+	for (int row = 0; row < l->height; ++row)
+	{
+		size_t const begin = l->binBegin[row];
+		size_t const end = l->binEnd[row];
+		real p;
+		switch (l->aggregation)
+		{
+		case AGGREGATE_MAX:
+			p = 0;
+			for (size_t j = begin; j < end; ++j)
+			{
+				if (power[j] > p) p = power[j];
+			}
+			break;
+		case AGGREGATE_MEAN:
+			p = 0;
+			for (size_t j = begin; j < end; ++j)
+				p += power[j];
+			p /= end - begin;
+			break;
+		default:
+			p = power[end - 1];
+			break;
+		}
+		amplitudes[row] = p;
+	}
+	simd_log_amplitude(amplitudes, l->height);
+}
@@ -0,0 +1,86 @@
+#ifndef SPECTROGEN__LAYOUT_H_
+#define SPECTROGEN__LAYOUT_H_
+
+#include <stddef.h>
+
+#include "spectrogen.h"
+
+enum FrequencyAxis
+{
+	AXIS_LINEAR,
+	AXIS_LOGARITHMIC,
+	/**
+	 * Logarithmic, with each row computed by a constant-Q kernel. See struct
+	 * ConstantQ. Rows are mapped onto components as AXIS_LOGARITHMIC.
+	 */
+	AXIS_CONSTANT_Q
+};
+
+struct ConstantQ;
+/**
+ * How the components covered by a row are combined into one amplitude
+ */
+enum Aggregation
+{
+	AGGREGATE_POINT, // Highest component of the row only
+	AGGREGATE_MAX,
+	AGGREGATE_MEAN // Mean power
+};
+
+/**
+ * Maps each row of the spectrogram onto a range of components of a spectrum
+ * with windowRadius + 1 components. Row 0 is the highest frequency.
+ */
+struct FrequencyLayout
+{
+	int height;
+	size_t windowRadius;
+	enum FrequencyAxis axis;
+	enum Aggregation aggregation;
+
+	// Populated by FrequencyLayout_init
+	/**
+	 * The rows show the part [low, high] of the axis, where 0 is the lowest
+	 * and 1 the highest frequency. See FrequencyLayout_zoom.
+	 */
+	real low, high;
+	/**
+	 * Row i covers the components [binBegin[i], binEnd[i])
+	 */
+	size_t* binBegin;
+	size_t* binEnd;
+	/**
+	 * If not NULL, the rows are computed from the complex spectra by
+	 * ConstantQ_eval instead of FrequencyLayout_eval. Set to NULL by
+	 * FrequencyLayout_init.
+	 */
+	struct ConstantQ const* constantQ;
+};
+
+/**
+ * Must be called after height, windowRadius, axis and aggregation are
+ * initialised
+ */
+void FrequencyLayout_init(struct FrequencyLayout* const);
+void FrequencyLayout_destroy(struct FrequencyLayout* const);
+/**
+ * @brief Maps the rows onto the part [low, high] of the axis. The whole axis
+ *  is [0, 1].
+ */
+void FrequencyLayout_zoom(struct FrequencyLayout* const, real low, real high);
+/**
+ * @brief The component, not rounded, at the height y of the rows, where 0 is
+ *  the bottom of the lowest row and 1 the top of the highest
+ */
+real FrequencyLayout_component(struct FrequencyLayout const* const, real y);
+/**
+ * @brief Combines the components of each row into a log amplitude, scaled so
+ *  that a sinusoid with unit amplitude maps to 0.
+ * @param[out] amplitudes An array of size height
+ * @param[in] power Squared magnitudes of the spectrum. An array of size
+ *  windowRadius + 1
+ */
+void FrequencyLayout_eval(struct FrequencyLayout const* const,
+                          real* const amplitudes, real const* const power);
+
+#endif // !SPECTROGEN__LAYOUT_H_
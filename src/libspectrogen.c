@@ -0,0 +1,125 @@
+#include "libspectrogen.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spectrogram.h"
+
+void Spectrogen_defaults(struct Spectrogen* const s)
+{
+	assert(s);
+	memset(s, 0, sizeof(struct Spectrogen));
+	s->width = 640;
+	s->height = 480;
+	s->windowWidth = 1536;
+	s->windowFunction = WINDOW_GAUSSIAN;
+	s->windowVar = 6.0;
+	s->axis = AXIS_LINEAR;
+	s->aggregation = AGGREGATE_MAX;
+	s->nThreads = 1;
+}
+bool Spectrogen_init(struct Spectrogen* const s)
+{
+	assert(s);
+	assert(s->width > 0 && s->height > 0);
+	if (s->nThreads == 0) s->nThreads = 1;
+
+	struct DSTFT dstft;
+	memset(&dstft, 0, sizeof(struct DSTFT));
+	dstft.windowWidth = s->windowWidth;
+	dstft.batchSize = s->batchSize;
+	dstft.wisdomDir = s->wisdomDir;
+	DSTFT_init(&dstft);
+	window_populate(dstft.window, dstft.windowWidth,
+	                s->windowFunction, s->windowVar);
+	s->dstfts = malloc(sizeof(struct DSTFT) * s->nThreads);
+	s->dstfts[0] = dstft;
+	for (size_t i = 1; i < s->nThreads; ++i)
+		DSTFT_init_copy(&s->dstfts[i], &dstft);
+	s->pool.nThreads = s->nThreads;
+	WorkerPool_init(&s->pool);
+	s->dstfts[0].pool = &s->pool;
+
+	s->layout.height = s->height;
+	s->layout.windowRadius = dstft.windowRadius;
+	s->layout.axis = s->axis;
+	s->layout.aggregation = s->aggregation;
+	FrequencyLayout_init(&s->layout);
+
+	ColourGradient_init_preset(&s->grad);
+
+	memset(&s->constantQ, 0, sizeof(struct ConstantQ));
+	if (s->axis == AXIS_CONSTANT_Q)
+	{
+		if (!ConstantQ_init(&s->constantQ, &s->layout, &s->dstfts[0]))
+		{
+			fprintf(stderr, "The constant-Q axis requires a window without "
+			        "zeros\n");
+			return false;
+		}
+		s->layout.constantQ = &s->constantQ;
+	}
+	return true;
+}
+void Spectrogen_destroy(struct Spectrogen* const s)
+{
+	if (!s) return;
+	WorkerPool_destroy(&s->pool);
+	if (s->dstfts)
+	{
+		for (size_t i = 0; i < s->nThreads; ++i)
+			DSTFT_destroy(&s->dstfts[i]);
+		free(s->dstfts);
+	}
+	FrequencyLayout_destroy(&s->layout);
+	if (s->constantQ.entryBegin) ConstantQ_destroy(&s->constantQ);
+	ColourGradient_destroy(&s->grad);
+}
+
+bool Spectrogen_render(struct Spectrogen* const s,
+                       struct SampleSource const* const source,
+                       uint8_t* const rgb)
+{
+	assert(s && s->dstfts);
+	if (source->nSamples < s->windowWidth)
+	{
+		fprintf(stderr, "Number of samples cannot be less than the window width\n");
+		return false;
+	}
+	struct SpectrogramImage image;
+	memset(&image, 0, sizeof(struct SpectrogramImage));
+	image.format = SPECTROGRAM_RGB24;
+	image.planes[0] = rgb;
+	image.pitches[0] = s->width * 3;
+	spectrogram_populate_image(&image, s->width, source, false,
+	                           &s->layout, &s->grad, s->dstfts, s->nThreads);
+	return true;
+}
+bool Spectrogen_amplitudes(struct Spectrogen* const s,
+                           struct SampleSource const* const source,
+                           real* const amplitudes)
+{
+	assert(s && s->dstfts);
+	if (source->nSamples < s->windowWidth)
+	{
+		fprintf(stderr, "Number of samples cannot be less than the window width\n");
+		return false;
+	}
+	size_t* const centres = malloc(sizeof(size_t) * s->width);
+	for (int col = 0; col < s->width; ++col)
+		centres[col] = spectrogram_centre(col, s->width, source->nSamples);
+	real* const columns = malloc(sizeof(real) * s->width * s->height);
+	spectrogram_amplitude_columns(columns, source, centres, s->width,
+	                              &s->layout, s->dstfts, s->nThreads);
+
+	for (int col = 0; col < s->width; ++col)
+	{
+		for (int row = 0; row < s->height; ++row)
+			amplitudes[col + row * s->width] = columns[col * s->height + row];
+	}
+	free(columns);
+	free(centres);
+	return true;
+}
@@ -0,0 +1,93 @@
+#ifndef SPECTROGEN__LIBSPECTROGEN_H_
+#define SPECTROGEN__LIBSPECTROGEN_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "constantq.h"
+#include "fourier.h"
+#include "gradient.h"
+#include "layout.h"
+#include "samplesource.h"
+#include "workerpool.h"
+
+/**
+ * Public entry of libspectrogen. Renders the spectrogram of a whole sample
+ * source into an image or an amplitude matrix, without a display.
+ */
+struct Spectrogen
+{
+	int width;
+	int height;
+	size_t windowWidth;
+	enum WindowFunction windowFunction;
+	/**
+	 * Passed to window_populate
+	 */
+	real windowVar;
+	/**
+	 * Number of frames transformed together. 0 is treated as 1.
+	 */
+	size_t batchSize;
+	enum FrequencyAxis axis;
+	enum Aggregation aggregation;
+	/**
+	 * Number of threads calculating the spectrogram. 0 is treated as 1.
+	 */
+	size_t nThreads;
+	/**
+	 * Directory of the FFTW wisdom cache, or NULL. See struct DSTFT.
+	 */
+	char const* wisdomDir;
+
+	// Populated by Spectrogen_init
+	/**
+	 * The threads of dstfts, started once. See struct WorkerPool.
+	 */
+	struct WorkerPool pool;
+	struct DSTFT* dstfts;
+	struct FrequencyLayout layout;
+	/**
+	 * The kernels of the rows, used when axis is AXIS_CONSTANT_Q
+	 */
+	struct ConstantQ constantQ;
+	/**
+	 * The preset gradient. It may be replaced before rendering.
+	 */
+	struct ColourGradient grad;
+};
+
+/**
+ * @brief Sets the fields to the defaults of the Spectrogen executable
+ */
+void Spectrogen_defaults(struct Spectrogen* const);
+/**
+ * Must be called after width, height, windowWidth, windowFunction, windowVar,
+ * batchSize, axis, aggregation, nThreads and wisdomDir are initialised
+ * @return false if axis is AXIS_CONSTANT_Q and the window has zeros. Then
+ *  Spectrogen_destroy must still be called.
+ */
+bool Spectrogen_init(struct Spectrogen* const);
+void Spectrogen_destroy(struct Spectrogen* const);
+/**
+ * @brief Renders the spectrogram of source, spread over the width columns.
+ *  Use SampleSource_init_array to render an array of samples.
+ * @param[out] rgb An array of size width * height * 3 in the RGB888 format,
+ *  row by row. Row 0 is the highest frequency.
+ * @return false if source has fewer samples than the window
+ */
+bool Spectrogen_render(struct Spectrogen* const,
+                       struct SampleSource const* const source,
+                       uint8_t* const rgb);
+/**
+ * @brief Same as Spectrogen_render, but stores the log amplitudes which
+ *  Spectrogen_render shades, instead of colours. A sinusoid with unit
+ *  amplitude maps to 0.
+ * @param[out] amplitudes An array of size width * height, row by row
+ */
+bool Spectrogen_amplitudes(struct Spectrogen* const,
+                           struct SampleSource const* const source,
+                           real* const amplitudes);
+
+#endif // !SPECTROGEN__LIBSPECTROGEN_H_
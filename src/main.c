@@ -5,65 +5,21 @@
 #include <stdbool.h>
 #include <assert.h>
 
+#include "batch.h"
+#include "constantq.h"
 #include "display.h"
 #include "fourier.h"
+#include "headless.h"
 #include "staticsample.h"
 #include "record.h"
 
 #include "gradient.h"
 
-void preset_gradient(struct ColourGradient* const grad)
-{
-	assert(grad);
-	size_t nPoints = 9;
-	ColourGradient_init(grad, nPoints);
-	grad->r.interpolation = grad->g.interpolation = grad->b.interpolation
-		= INTERP_SPLINE3;
-
-	real* const r = grad->r.y;
-	real* const g = grad->g.y;
-	real* const b = grad->b.y;
-
-	real* const x = grad->r.x;
-
-#define COLOUR_SET(index, t, red, green, blue) \
-	x[index] = t; \
-	r[index] = red; g[index] = green; b[index] = blue;
-
-	COLOUR_SET(0, -12, 0.0, 0.0, 0.0);
-	COLOUR_SET(1, -7.2, 31, 0, 0);
-	COLOUR_SET(2, -6.5, 61, 13, 2);
-	COLOUR_SET(3, -5.5, 204, 34, 22);
-	COLOUR_SET(4, -4, 238, 191, 40);
-	COLOUR_SET(5, -3, 32, 194, 111);
-	COLOUR_SET(6, -2, 37, 105, 245);
-	COLOUR_SET(7, -1, 200, 170, 255);
-	COLOUR_SET(8, 0, 255, 255, 255);
-
-	for (size_t i = 0; i < nPoints; ++i)
-	{
-		real fac = 2.0 / (3.0 - i / (real) nPoints);
-		r[i] *= fac;
-		g[i] *= fac;
-		b[i] *= fac;
-	}
-	memcpy(grad->g.x, x, sizeof(real) * nPoints);
-	memcpy(grad->b.x, x, sizeof(real) * nPoints);
-	ColourGradient_populate(grad);
-}
 int main(int argc, char* argv[])
 {
 	(void) argc;
 	(void) argv;
 
-	// Initialisation
-
-	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER))
-	{
-		fprintf(stderr, "[SDL] %s\n", SDL_GetError());
-		return -1;
-	}
-
 	// Default values
 	struct Display display;
 	Display_init(&display);
@@ -75,20 +31,37 @@ int main(int argc, char* argv[])
 		ROUTINE_STATIC,
 		ROUTINE_RECORD
 	} routineType = ROUTINE_RECORD;
-	enum
-	{
-		WINDOW_RECT,
-		WINDOW_TRI,
-		WINDOW_GAUSSIAN,
-		WINDOW_EXPCAUSAL
-	} windowType = WINDOW_GAUSSIAN;
+	enum WindowFunction windowType = WINDOW_GAUSSIAN;
 	real windowVar = 6.0;
+#ifdef SPECTROGRAM_LOGARITHMIC
+	display.frequencyLayout.axis = AXIS_LOGARITHMIC;
+#else
+	display.frequencyLayout.axis = AXIS_LINEAR;
+#endif
+	display.frequencyLayout.aggregation = AGGREGATE_MAX;
 
 	struct DSTFT dstft;
 	memset(&dstft, 0, sizeof(struct DSTFT));
 	dstft.windowWidth = 1536;
 	char const* file = NULL;
+	enum SampleFileType fileType = SAMPLEFILE_AUTO;
+	size_t chunkSize = 0;
 	size_t nSamples = 88200;
+	size_t nThreads = 1;
+	size_t minHop = 0;
+	bool sliding = false;
+	struct ZoomFilter zoom;
+	memset(&zoom, 0, sizeof(struct ZoomFilter));
+	zoom.sampleRate = RECORD_SAMPLE_RATE;
+	zoom.fmax = RECORD_SAMPLE_RATE / 2;
+	bool zoomed = false;
+	char const* output = NULL;
+	bool amplitudes = false;
+	char const* fileList = NULL;
+	char const* outputDir = ".";
+	enum ImageFileType outputType = IMAGEFILE_PNG;
+	unsigned trainRigor = 0;
+	char const* trainWidths = NULL;
 
 	// Command line parser
 	char** arg= argv;
@@ -99,19 +72,70 @@ int main(int argc, char* argv[])
 	{
 		printf("Usage:\n"
 		       "Spectrogram specifications:\n"
-		       "--dim WIDTH HEIGHT: Dimensions of the output window\n"
+		       "--dim WIDTH HEIGHT: Dimensions of the output window, which"
+		       " must be even, or of the images of --output and --files\n"
 		       "--window TYPE WIDTH VAR: Specs of the window function\n"
 		       "    TYPE: Can have the value 'rect', 'tri', 'gauss', 'expc'\n"
 		       "    WIDTH: Number of samples for the window.\n"
 		       "    VAR: Higher var indicates a narrower window. Ignored for rect"
 		       " and tri types\n"
+		       "--axis TYPE: Can have the value 'lin', 'log' or 'cq'. 'cq' is"
+		       " a logarithmic axis with constant-Q kernels, whose time"
+		       " resolution increases with frequency. Requires a window without"
+		       " zeros. The static display cannot zoom frequency with it\n"
+		       "--aggregate TYPE: Combines the frequencies in a row by 'point',"
+		       " 'max' or 'mean'\n"
 		       "--ns NSAMPLES: The number of samples for various routines\n"
+		       "--batch NFRAMES: Number of frames transformed together\n"
+		       "--threads NTHREADS: Number of threads calculating the spectrogram\n"
+		       "--wisdom DIR: Load FFTW plans from DIR, and save new ones to it\n"
+		       "--wisdom-train RIGOR WIDTHS: Plan with the rigor 'measure',"
+		       " 'patient' or 'exhaustive' for each window width of the comma"
+		       " separated list WIDTHS, save the plans to --wisdom and exit."
+		       " WIDTHS defaults to the width of --window\n"
+		       "--zero-copy: Draw directly into the locked texture memory\n"
+		       "--fps FPS: Maximum frames drawn per second. 0 for unlimited\n"
+		       "--vsync: Synchronise with the refresh of the display\n"
+		       "--queue DEPTH: Number of frames waiting to be drawn\n"
+		       "--latest: Always draw the newest frame, dropping older ones\n"
+		       "--hop NSAMPLES: Minimum number of new samples before the"
+		       " spectrogram is redrawn. Defaults to one column\n"
+		       "--sliding: Update the displayed frequencies on every sample"
+		       " instead of transforming each column. Faster for short hops."
+		       " Requires the 'rect' or 'expc' window\n"
+		       "--fmin HZ, --fmax HZ: Show only the band [fmin, fmax] of the"
+		       " microphone. The samples are shifted, filtered and decimated"
+		       " before the transform, so the window resolves the band finer."
+		       " --ns and --hop still count captured samples. Requires the"
+		       " 'lin' axis\n"
+		       "--profile FILENAME: Write the time spent in each stage every"
+		       " second, as JSON if FILENAME ends with '.json' and CSV otherwise."
+		       " Requires a build with SPECTROGEN_PROFILE\n"
 		       "Modes:\n"
 		       "(NO FLAG): Accept input from the microphone\n"
 		       "--file FILENAME: Read samples from a file. The first line must be"
 		       " the number of samples, with sample values following on separate"
 		       " lines\n"
+		       "--format TYPE: Format of the file. Can have the value 'auto',"
+		       " 'text', 'wav', 's16', 's24' or 'f32'. The last three are"
+		       " headerless little endian mono samples. 'auto' reads WAV files and"
+		       " text otherwise\n"
+		       "--stream NSAMPLES: Stream the file in chunks of NSAMPLES samples"
+		       " instead of loading it whole\n"
 		       "--default: Use a set of default generated samples\n"
+		       "--output FILENAME: Write the spectrogram of --file to FILENAME"
+		       " without opening a window. The format is taken from the"
+		       " extension: '.png', '.ppm', or raw RGB otherwise\n"
+		       "--amplitudes: With --output, write the log amplitudes as raw"
+		       " 32 bit floats instead of colours\n"
+		       "--files PATH: Render every file of a directory, or every file"
+		       " named in a list with one name per line, without opening a"
+		       " window. --threads files are rendered at a time\n"
+		       "--outdir DIR: Directory of the images of --files, named after"
+		       " the input file with the image extension appended. Defaults to"
+		       " the current directory\n"
+		       "--outformat TYPE: Format of the images of --files. Can have the"
+		       " value 'png', 'ppm' or 'raw'\n"
 		      );
 		return 1;
 	}
@@ -131,6 +155,11 @@ int main(int argc, char* argv[])
 				return -1;
 			}
 			display.height = atoi(*arg);
+			if (display.width <= 0 || display.height <= 0)
+			{
+				fprintf(stderr, "Dimensions must be positive\n");
+				return -1;
+			}
 		}
 		else if (strcmp(*arg, "--window") == 0)
 		{
@@ -162,6 +191,44 @@ int main(int argc, char* argv[])
 			if (++arg == argEnd || *arg[0] == '-') break;
 			windowVar = atof(*arg);
 		}
+		else if (strcmp(*arg, "--axis") == 0)
+		{
+			if (++arg == argEnd || *arg[0] == '-')
+			{
+				fprintf(stderr, "Axis type must be supplied after --axis\n");
+				return -1;
+			}
+			if (strcmp(*arg, "lin") == 0)
+				display.frequencyLayout.axis = AXIS_LINEAR;
+			else if (strcmp(*arg, "log") == 0)
+				display.frequencyLayout.axis = AXIS_LOGARITHMIC;
+			else if (strcmp(*arg, "cq") == 0)
+				display.frequencyLayout.axis = AXIS_CONSTANT_Q;
+			else
+			{
+				fprintf(stderr, "Unrecognised axis type\n");
+				return -1;
+			}
+		}
+		else if (strcmp(*arg, "--aggregate") == 0)
+		{
+			if (++arg == argEnd || *arg[0] == '-')
+			{
+				fprintf(stderr, "Aggregation must be supplied after --aggregate\n");
+				return -1;
+			}
+			if (strcmp(*arg, "point") == 0)
+				display.frequencyLayout.aggregation = AGGREGATE_POINT;
+			else if (strcmp(*arg, "max") == 0)
+				display.frequencyLayout.aggregation = AGGREGATE_MAX;
+			else if (strcmp(*arg, "mean") == 0)
+				display.frequencyLayout.aggregation = AGGREGATE_MEAN;
+			else
+			{
+				fprintf(stderr, "Unrecognised aggregation\n");
+				return -1;
+			}
+		}
 		else if (strcmp(*arg, "--file") == 0)
 		{
 			if (++arg == argEnd)
@@ -172,6 +239,45 @@ int main(int argc, char* argv[])
 			file = *arg;
 			routineType = ROUTINE_STATIC;
 		}
+		else if (strcmp(*arg, "--format") == 0)
+		{
+			if (++arg == argEnd)
+			{
+				fprintf(stderr, "A format must be provided after --format\n");
+				return -1;
+			}
+			if (strcmp(*arg, "auto") == 0)
+				fileType = SAMPLEFILE_AUTO;
+			else if (strcmp(*arg, "text") == 0)
+				fileType = SAMPLEFILE_TEXT;
+			else if (strcmp(*arg, "wav") == 0)
+				fileType = SAMPLEFILE_WAV;
+			else if (strcmp(*arg, "s16") == 0)
+				fileType = SAMPLEFILE_S16LE;
+			else if (strcmp(*arg, "s24") == 0)
+				fileType = SAMPLEFILE_S24LE;
+			else if (strcmp(*arg, "f32") == 0)
+				fileType = SAMPLEFILE_F32LE;
+			else
+			{
+				fprintf(stderr, "Unrecognised file format\n");
+				return -1;
+			}
+		}
+		else if (strcmp(*arg, "--stream") == 0)
+		{
+			if (++arg == argEnd || *arg[0] == '-')
+			{
+				fprintf(stderr, "A chunk size must be provided after --stream\n");
+				return -1;
+			}
+			chunkSize = atol(*arg);
+			if (chunkSize == 0)
+			{
+				fprintf(stderr, "Invalid chunk size\n");
+				return -1;
+			}
+		}
 		else if (strcmp(*arg, "--ns") == 0)
 		{
 			if (++arg == argEnd || *arg[0] == '-')
@@ -181,6 +287,198 @@ int main(int argc, char* argv[])
 			}
 			nSamples = atol(*arg);
 		}
+		else if (strcmp(*arg, "--batch") == 0)
+		{
+			if (++arg == argEnd || *arg[0] == '-')
+			{
+				fprintf(stderr, "A number of frames must be provided after --batch\n");
+				return -1;
+			}
+			dstft.batchSize = atol(*arg);
+			if (dstft.batchSize == 0)
+			{
+				fprintf(stderr, "Invalid batch size\n");
+				return -1;
+			}
+		}
+		else if (strcmp(*arg, "--queue") == 0)
+		{
+			if (++arg == argEnd || *arg[0] == '-')
+			{
+				fprintf(stderr, "A queue depth must be provided after --queue\n");
+				return -1;
+			}
+			display.pictQueueDepth = atol(*arg);
+			if (display.pictQueueDepth == 0 ||
+			    display.pictQueueDepth > DISPLAY_PICTQUEUE_SIZE_MAX)
+			{
+				fprintf(stderr, "Queue depth must be between 1 and %d\n",
+				        DISPLAY_PICTQUEUE_SIZE_MAX);
+				return -1;
+			}
+		}
+		else if (strcmp(*arg, "--hop") == 0)
+		{
+			if (++arg == argEnd || *arg[0] == '-')
+			{
+				fprintf(stderr, "A number of samples must be provided after --hop\n");
+				return -1;
+			}
+			minHop = atol(*arg);
+		}
+		else if (strcmp(*arg, "--fmin") == 0 || strcmp(*arg, "--fmax") == 0)
+		{
+			bool const isMin = strcmp(*arg, "--fmin") == 0;
+			if (++arg == argEnd || *arg[0] == '-')
+			{
+				fprintf(stderr, "A frequency must be provided after %s\n",
+				        isMin ? "--fmin" : "--fmax");
+				return -1;
+			}
+			if (isMin)
+				zoom.fmin = atof(*arg);
+			else
+				zoom.fmax = atof(*arg);
+			zoomed = true;
+		}
+		else if (strcmp(*arg, "--sliding") == 0)
+		{
+			sliding = true;
+		}
+		else if (strcmp(*arg, "--latest") == 0)
+		{
+			display.pictQueueMode = PICTQUEUE_LATEST;
+		}
+		else if (strcmp(*arg, "--fps") == 0)
+		{
+			if (++arg == argEnd || *arg[0] == '-')
+			{
+				fprintf(stderr, "A frame rate must be provided after --fps\n");
+				return -1;
+			}
+			display.fps = atoi(*arg);
+			if (display.fps > 1000)
+			{
+				fprintf(stderr, "Frame rate cannot exceed 1000\n");
+				return -1;
+			}
+		}
+		else if (strcmp(*arg, "--vsync") == 0)
+		{
+			display.vsync = true;
+		}
+		else if (strcmp(*arg, "--zero-copy") == 0)
+		{
+			display.zeroCopy = true;
+		}
+		else if (strcmp(*arg, "--threads") == 0)
+		{
+			if (++arg == argEnd || *arg[0] == '-')
+			{
+				fprintf(stderr, "A number of threads must be provided after --threads\n");
+				return -1;
+			}
+			nThreads = atol(*arg);
+			if (nThreads == 0)
+			{
+				fprintf(stderr, "Invalid number of threads\n");
+				return -1;
+			}
+		}
+		else if (strcmp(*arg, "--output") == 0)
+		{
+			if (++arg == argEnd)
+			{
+				fprintf(stderr, "A file name must be provided after --output\n");
+				return -1;
+			}
+			output = *arg;
+		}
+		else if (strcmp(*arg, "--amplitudes") == 0)
+		{
+			amplitudes = true;
+		}
+		else if (strcmp(*arg, "--files") == 0)
+		{
+			if (++arg == argEnd)
+			{
+				fprintf(stderr, "A directory or list must be provided after --files\n");
+				return -1;
+			}
+			fileList = *arg;
+		}
+		else if (strcmp(*arg, "--outdir") == 0)
+		{
+			if (++arg == argEnd)
+			{
+				fprintf(stderr, "A directory must be provided after --outdir\n");
+				return -1;
+			}
+			outputDir = *arg;
+		}
+		else if (strcmp(*arg, "--outformat") == 0)
+		{
+			if (++arg == argEnd || *arg[0] == '-')
+			{
+				fprintf(stderr, "A format must be provided after --outformat\n");
+				return -1;
+			}
+			if (strcmp(*arg, "png") == 0)
+				outputType = IMAGEFILE_PNG;
+			else if (strcmp(*arg, "ppm") == 0)
+				outputType = IMAGEFILE_PPM;
+			else if (strcmp(*arg, "raw") == 0)
+				outputType = IMAGEFILE_RAW;
+			else
+			{
+				fprintf(stderr, "Unrecognised image format\n");
+				return -1;
+			}
+		}
+		else if (strcmp(*arg, "--wisdom") == 0)
+		{
+			if (++arg == argEnd)
+			{
+				fprintf(stderr, "A directory must be provided after --wisdom\n");
+				return -1;
+			}
+			dstft.wisdomDir = *arg;
+		}
+		else if (strcmp(*arg, "--wisdom-train") == 0)
+		{
+			if (++arg == argEnd || *arg[0] == '-')
+			{
+				fprintf(stderr, "A rigor must be provided after --wisdom-train\n");
+				return -1;
+			}
+			if (strcmp(*arg, "measure") == 0)
+				trainRigor = FFTW_MEASURE;
+			else if (strcmp(*arg, "patient") == 0)
+				trainRigor = FFTW_PATIENT;
+			else if (strcmp(*arg, "exhaustive") == 0)
+				trainRigor = FFTW_EXHAUSTIVE;
+			else
+			{
+				fprintf(stderr, "Unrecognised rigor\n");
+				return -1;
+			}
+			if (arg + 1 != argEnd && arg[1][0] != '-')
+				trainWidths = *++arg;
+		}
+		else if (strcmp(*arg, "--profile") == 0)
+		{
+			if (++arg == argEnd)
+			{
+				fprintf(stderr, "A file name must be provided after --profile\n");
+				return -1;
+			}
+#ifdef SPECTROGEN_PROFILE
+			if (!Profile_open(&display.profile, *arg)) return -1;
+#else
+			fprintf(stderr, "--profile requires a build with SPECTROGEN_PROFILE\n");
+			return -1;
+#endif
+		}
 		else if (strcmp(*arg, "--default") == 0)
 		{
 			file = NULL;
@@ -192,55 +490,187 @@ int main(int argc, char* argv[])
 			return -1;
 		}
 	}
+	if (zoomed)
+	{
+		if (routineType != ROUTINE_RECORD || output || fileList)
+		{
+			fprintf(stderr, "--fmin and --fmax require the microphone\n");
+			return -1;
+		}
+		if (display.frequencyLayout.axis != AXIS_LINEAR)
+		{
+			fprintf(stderr, "--fmin and --fmax require the 'lin' axis\n");
+			return -1;
+		}
+		if (!ZoomFilter_init(&zoom)) return -1;
+		// The history and the hop are decimated with the samples
+		nSamples /= zoom.decimation;
+		if (minHop)
+			minHop = (minHop + zoom.decimation - 1) / zoom.decimation;
+	}
 	if (nSamples < dstft.windowWidth)
 	{
 		fprintf(stderr, "Sample size cannot be smaller than the window width\n");
 		return -1;
 	}
+	if (display.frequencyLayout.axis == AXIS_CONSTANT_Q && sliding)
+	{
+		fprintf(stderr, "--sliding cannot be used with the 'cq' axis\n");
+		return -1;
+	}
+
+	// Train the wisdom cache
+	if (trainRigor)
+	{
+		if (!dstft.wisdomDir)
+		{
+			fprintf(stderr, "--wisdom-train requires --wisdom\n");
+			return -1;
+		}
+		char const* widths = trainWidths;
+		do
+		{
+			struct DSTFT train;
+			memset(&train, 0, sizeof(struct DSTFT));
+			train.windowWidth = widths ? strtoul(widths, NULL, 10) :
+			                             dstft.windowWidth;
+			train.batchSize = dstft.batchSize;
+			train.wisdomDir = dstft.wisdomDir;
+			train.planRigor = trainRigor;
+			if (train.windowWidth == 0)
+			{
+				fprintf(stderr, "Invalid window width\n");
+				return -1;
+			}
+			Uint64 const timeStart = SDL_GetPerformanceCounter();
+			DSTFT_init(&train);
+			double const seconds = (SDL_GetPerformanceCounter() - timeStart) /
+			                       (double) SDL_GetPerformanceFrequency();
+			fprintf(stdout, "Window width %zu: Planned in %.3f s\n",
+			        train.windowWidth, seconds);
+			DSTFT_destroy(&train);
+			if (widths) widths = strchr(widths, ',');
+		} while (widths && *++widths);
+		return 0;
+	}
+
+	// Headless and batch modes do not touch SDL video
+	if (output || fileList)
+	{
+		if (output && !file)
+		{
+			fprintf(stderr, "--output requires --file\n");
+			return -1;
+		}
+		struct Spectrogen spectrogen;
+		Spectrogen_defaults(&spectrogen);
+		spectrogen.width = display.width;
+		spectrogen.height = display.height;
+		spectrogen.windowWidth = dstft.windowWidth;
+		spectrogen.windowFunction = windowType;
+		spectrogen.windowVar = windowVar;
+		spectrogen.batchSize = dstft.batchSize;
+		spectrogen.axis = display.frequencyLayout.axis;
+		spectrogen.aggregation = display.frequencyLayout.aggregation;
+		spectrogen.nThreads = nThreads;
+		spectrogen.wisdomDir = dstft.wisdomDir;
+		bool success = Spectrogen_init(&spectrogen);
+		if (success && fileList)
+			success = batch_exec(&spectrogen, fileList, fileType,
+			                     outputDir, outputType);
+		else if (success)
+			success = headless_exec(&spectrogen, file, fileType,
+			                        output, amplitudes);
+		Spectrogen_destroy(&spectrogen);
+		return success ? 0 : -1;
+	}
+
+	// The chroma planes of the YV12 textures have half the dimensions
+	if (display.width % 2 || display.height % 2)
+	{
+		fprintf(stderr, "Dimensions of the window must be even\n");
+		return -1;
+	}
+	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER))
+	{
+		fprintf(stderr, "[SDL] %s\n", SDL_GetError());
+		return -1;
+	}
 
 	// Parsing complete. Populate fields
 	display.window =
 	  SDL_CreateWindow("Spectrogen",
 	                   SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
 	                   display.width, display.height, 0);
-	display.swsContext = sws_getContext(display.width, display.height,
-	                                    AV_PIX_FMT_RGB24,
-	                                    display.width, display.height,
-	                                    DISPLAY_PICTQUEUE_PIXFMT, SWS_BILINEAR,
-	                                    NULL, NULL, NULL);
 
-	Display_pictQueue_init(&display);
-	preset_gradient(&display.colourGradient);
+	if (!display.window || !Display_pictQueue_init(&display))
+	{
+		fprintf(stderr, "[SDL] Unable to create the display: %s\n",
+		        SDL_GetError());
+		Display_destroy(&display);
+		SDL_Quit();
+		return -1;
+	}
+	ColourGradient_init_preset(&display.colourGradient);
 
 	DSTFT_init(&dstft);
-	switch (windowType)
+	window_populate(dstft.window, dstft.windowWidth, windowType, windowVar);
+	display.frequencyLayout.height = display.height;
+	display.frequencyLayout.windowRadius = dstft.windowRadius;
+	FrequencyLayout_init(&display.frequencyLayout);
+	struct ConstantQ constantQ;
+	memset(&constantQ, 0, sizeof(struct ConstantQ));
+	if (display.frequencyLayout.axis == AXIS_CONSTANT_Q)
 	{
-	case WINDOW_RECT:
-		window_rect(dstft.window, dstft.windowWidth);
-		break;
-	case WINDOW_TRI:
-		window_tri(dstft.window, dstft.windowWidth);
-		break;
-	case WINDOW_GAUSSIAN:
-		window_gaussian(dstft.window, dstft.windowWidth, windowVar);
-		break;
-	case WINDOW_EXPCAUSAL:
-		window_exponential_causal(dstft.window, dstft.windowWidth, windowVar);
-		break;
+		if (!ConstantQ_init(&constantQ, &display.frequencyLayout, &dstft))
+		{
+			fprintf(stderr, "The 'cq' axis requires a window without zeros\n");
+			DSTFT_destroy(&dstft);
+			Display_pictQueue_destroy(&display);
+			Display_destroy(&display);
+			SDL_Quit();
+			return -1;
+		}
+		display.frequencyLayout.constantQ = &constantQ;
+	}
+
+	if (zoomed)
+	{
+		// The layout maps the component j + 1 to j / windowRadius of the axis
+		real const offset = 1 / (real) display.frequencyLayout.windowRadius;
+		FrequencyLayout_zoom(&display.frequencyLayout,
+		                     zoom.low - offset, zoom.high - offset);
 	}
 
+	// One workspace per calculation thread
+	struct DSTFT* const dstfts = malloc(sizeof(struct DSTFT) * nThreads);
+	dstfts[0] = dstft;
+	for (size_t i = 1; i < nThreads; ++i)
+		DSTFT_init_copy(&dstfts[i], &dstft);
+	struct WorkerPool pool;
+	pool.nThreads = nThreads;
+	WorkerPool_init(&pool);
+	dstfts[0].pool = &pool;
+
 	switch (routineType)
 	{
 	case ROUTINE_STATIC:
-		static_sample_exec(&display, &dstft, file, nSamples);
+		static_sample_exec(&display, dstfts, nThreads, file, fileType,
+		                   nSamples, chunkSize);
 		break;
 	case ROUTINE_RECORD:
-		record_exec(&display, &dstft, nSamples);
+		record_exec(&display, dstfts, nThreads, nSamples, minHop, sliding,
+		            zoomed ? &zoom : NULL);
 		break;
 	}
 
 	// Clean up
-	DSTFT_destroy(&dstft);
+	WorkerPool_destroy(&pool);
+	for (size_t i = 0; i < nThreads; ++i)
+		DSTFT_destroy(&dstfts[i]);
+	free(dstfts);
+	if (constantQ.entryBegin) ConstantQ_destroy(&constantQ);
+	if (zoomed) ZoomFilter_destroy(&zoom);
 	Display_pictQueue_destroy(&display);
 	Display_destroy(&display);
 	SDL_Quit();
@@ -0,0 +1,277 @@
+#include "profile.h"
+
+#ifdef SPECTROGEN_PROFILE
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char const* const profile_stage_names[PROFILE_STAGE_COUNT] =
+{
+	"sample_wait", "queue_wait", "snapshot", "fft", "shade", "unwrap", "upload",
+	"present",
+};
+
+void Profile_init(struct Profile* const p)
+{
+	assert(p);
+	if (p->period == 0) p->period = 1000;
+	p->histograms = calloc(PROFILE_STAGE_COUNT, sizeof(struct ProfileHistogram));
+	p->previous = calloc(PROFILE_STAGE_COUNT, sizeof(*p->previous));
+	memset(p->previousSums, 0, sizeof(p->previousSums));
+	memset(p->maxima, 0, sizeof(p->maxima));
+	memset(p->stats, 0, sizeof(p->stats));
+	p->fps = 0.0;
+	p->queueDepth = 0;
+	p->timeStart = p->lastUpdate = SDL_GetTicks();
+	p->lastFrames = 0;
+	p->dump = NULL;
+	p->json = false;
+}
+void Profile_destroy(struct Profile* const p)
+{
+	if (!p) return;
+	if (p->dump) fclose(p->dump);
+	free(p->histograms);
+	free(p->previous);
+}
+bool Profile_open(struct Profile* const p, char const* const fileName)
+{
+	assert(p);
+	FILE* const f = fopen(fileName, "w");
+	if (!f)
+	{
+		perror(fileName);
+		return false;
+	}
+	if (p->dump) fclose(p->dump);
+	p->dump = f;
+	size_t const length = strlen(fileName);
+	p->json = length >= 5 && strcmp(fileName + length - 5, ".json") == 0;
+	if (!p->json)
+		fprintf(f, "time_s,stage,count,p50_us,p99_us,max_us,mean_us,"
+		        "fps,queue_depth\n");
+	return true;
+}
+
+/**
+ * @brief Representative duration of a bucket in ticks
+ */
+static double profile_bucket_value(size_t bucket)
+{
+	if (bucket < PROFILE_SUB_BUCKETS) return bucket;
+	int const exponent = bucket / PROFILE_SUB_BUCKETS + 2;
+	uint64_t const mantissa = PROFILE_SUB_BUCKETS + bucket % PROFILE_SUB_BUCKETS;
+	// Middle of [mantissa, mantissa + 1) << (exponent - 3)
+	return (mantissa + 0.5) * (double) ((uint64_t) 1 << (exponent - 3));
+}
+/**
+ * @brief Summarises the counts of a histogram
+ * @param max Longest duration in ticks, which bounds the percentiles
+ */
+static void profile_stats(struct ProfileStats* const stats,
+                          uint64_t const* const counts, uint64_t sum,
+                          uint64_t max)
+{
+	double const us = 1e6 / (double) SDL_GetPerformanceFrequency();
+	memset(stats, 0, sizeof(struct ProfileStats));
+	for (size_t i = 0; i < PROFILE_BUCKETS; ++i)
+		stats->count += counts[i];
+	if (stats->count == 0) return;
+
+	uint64_t const rank50 = (stats->count + 1) / 2;
+	uint64_t const rank99 = stats->count - stats->count / 100;
+	uint64_t cumulative = 0;
+	double p50 = 0.0, p99 = 0.0;
+	for (size_t i = 0; i < PROFILE_BUCKETS && cumulative < rank99; ++i)
+	{
+		if (!counts[i]) continue;
+		if (cumulative < rank50 && cumulative + counts[i] >= rank50)
+			p50 = profile_bucket_value(i);
+		cumulative += counts[i];
+		if (cumulative >= rank99) p99 = profile_bucket_value(i);
+	}
+	if (p50 > max) p50 = max;
+	if (p99 > max) p99 = max;
+	stats->p50 = p50 * us;
+	stats->p99 = p99 * us;
+	stats->max = max * us;
+	stats->mean = sum * us / stats->count;
+}
+
+static void profile_dump(struct Profile* const p, double time)
+{
+	FILE* const f = p->dump;
+	if (p->json)
+	{
+		fprintf(f, "{\"time_s\": %.3f, \"fps\": %.2f, \"queue_depth\": %zu, "
+		        "\"stages\": {", time, p->fps, p->queueDepth);
+		for (int s = 0; s < PROFILE_STAGE_COUNT; ++s)
+		{
+			struct ProfileStats const* const st = &p->stats[s];
+			fprintf(f, "%s\"%s\": {\"count\": %llu, \"p50_us\": %.3f, "
+			        "\"p99_us\": %.3f, \"max_us\": %.3f, \"mean_us\": %.3f}",
+			        s ? ", " : "", profile_stage_names[s],
+			        (unsigned long long) st->count,
+			        st->p50, st->p99, st->max, st->mean);
+		}
+		fprintf(f, "}}\n");
+	}
+	else
+	{
+		for (int s = 0; s < PROFILE_STAGE_COUNT; ++s)
+		{
+			struct ProfileStats const* const st = &p->stats[s];
+			fprintf(f, "%.3f,%s,%llu,%.3f,%.3f,%.3f,%.3f,%.2f,%zu\n",
+			        time, profile_stage_names[s], (unsigned long long) st->count,
+			        st->p50, st->p99, st->max, st->mean, p->fps, p->queueDepth);
+		}
+	}
+	fflush(f);
+}
+void Profile_update(struct Profile* const p,
+                    size_t nFramesDrawn, size_t queueDepth)
+{
+	assert(p && p->histograms);
+	uint32_t const now = SDL_GetTicks();
+	uint32_t const elapsed = now - p->lastUpdate;
+	if (elapsed < p->period) return;
+
+	for (int s = 0; s < PROFILE_STAGE_COUNT; ++s)
+	{
+		struct ProfileHistogram* const h = &p->histograms[s];
+		uint64_t counts[PROFILE_BUCKETS];
+		for (size_t i = 0; i < PROFILE_BUCKETS; ++i)
+		{
+			uint64_t const count = h->counts[i];
+			counts[i] = count - p->previous[s][i];
+			p->previous[s][i] = count;
+		}
+		uint64_t const sum = h->sum;
+		uint64_t const max = atomic_exchange(&h->max, 0);
+		/*
+		 * A duration recorded while the counts are read may be missing from
+		 * one of counts, sum or max. It is counted in the next period.
+		 */
+		profile_stats(&p->stats[s], counts, sum - p->previousSums[s], max);
+		p->previousSums[s] = sum;
+		if (max > p->maxima[s]) p->maxima[s] = max;
+	}
+	p->fps = (nFramesDrawn - p->lastFrames) * 1000.0 / elapsed;
+	p->queueDepth = queueDepth;
+	p->lastFrames = nFramesDrawn;
+	p->lastUpdate = now;
+
+	if (p->dump) profile_dump(p, (now - p->timeStart) / 1000.0);
+}
+
+/**
+ * 3x5 glyphs. Each octal digit is a row, top first, with the most
+ * significant bit on the left.
+ */
+static uint16_t profile_glyph(char c)
+{
+	static uint16_t const digits[] =
+	{
+		075557, 026227, 071747, 071717, 055711,
+		074717, 074757, 071111, 075757, 075717,
+	};
+	static uint16_t const letters[] =
+	{
+		025755, 065656, 034443, 065556, 074647, 074644, 034553, 055755, 072227,
+		011152, 055655, 044447, 057755, 065555, 025552, 065644, 025563, 065655,
+		034216, 072222, 055557, 055552, 055775, 055255, 055222, 071247,
+	};
+	if (c >= '0' && c <= '9') return digits[c - '0'];
+	c = toupper((unsigned char) c);
+	if (c >= 'A' && c <= 'Z') return letters[c - 'A'];
+	switch (c)
+	{
+	case '.': return 000002;
+	case '/': return 011244;
+	case ':': return 002020;
+	case '-': return 000700;
+	default: return 0;
+	}
+}
+/**
+ * @brief Draws a line of text with its top left corner at (x, y)
+ */
+static void profile_text(SDL_Renderer* const renderer, int x, int y, int scale,
+                         char const* const text)
+{
+	size_t const length = strlen(text);
+	SDL_Rect rects[15 * length + 1];
+	int nRects = 0;
+	for (size_t i = 0; i < length; ++i)
+	{
+		uint16_t const glyph = profile_glyph(text[i]);
+		for (int bit = 0; bit < 15; ++bit)
+		{
+			if (!(glyph & (1 << (14 - bit)))) continue;
+			rects[nRects].x = x + (4 * i + bit % 3) * scale;
+			rects[nRects].y = y + (bit / 3) * scale;
+			rects[nRects].w = rects[nRects].h = scale;
+			++nRects;
+		}
+	}
+	if (nRects) SDL_RenderFillRects(renderer, rects, nRects);
+}
+void Profile_draw(struct Profile* const p, SDL_Renderer* const renderer)
+{
+	assert(p);
+	if (!p->overlay) return;
+	int const scale = 2;
+	int const lineHeight = 7 * scale;
+	int const nLines = PROFILE_STAGE_COUNT + 2;
+	char line[64];
+
+	SDL_Rect background = { 0, 0, 0, 0 };
+	background.w = (4 * 28 + 2) * scale;
+	background.h = nLines * lineHeight + 2 * scale;
+	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 160);
+	SDL_RenderFillRect(renderer, &background);
+	SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+
+	int y = 2 * scale;
+	snprintf(line, sizeof(line), "FPS %.1f QUEUE %zu", p->fps, p->queueDepth);
+	profile_text(renderer, 2 * scale, y, scale, line);
+	y += lineHeight;
+	snprintf(line, sizeof(line), "%-11s %7s %7s", "US", "P50", "P99");
+	profile_text(renderer, 2 * scale, y, scale, line);
+	y += lineHeight;
+	for (int s = 0; s < PROFILE_STAGE_COUNT; ++s)
+	{
+		snprintf(line, sizeof(line), "%-11s %7.1f %7.1f",
+		         profile_stage_names[s], p->stats[s].p50, p->stats[s].p99);
+		profile_text(renderer, 2 * scale, y, scale, line);
+		y += lineHeight;
+	}
+	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+	// SDL_RenderClear uses the draw colour
+	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+}
+void Profile_report(struct Profile* const p)
+{
+	assert(p && p->histograms);
+	fprintf(stdout, "%-11s %10s %10s %10s %10s %10s\n",
+	        "Stage", "Count", "p50 (us)", "p99 (us)", "Max (us)", "Mean (us)");
+	for (int s = 0; s < PROFILE_STAGE_COUNT; ++s)
+	{
+		struct ProfileHistogram* const h = &p->histograms[s];
+		uint64_t counts[PROFILE_BUCKETS];
+		for (size_t i = 0; i < PROFILE_BUCKETS; ++i)
+			counts[i] = h->counts[i];
+		uint64_t max = h->max;
+		if (p->maxima[s] > max) max = p->maxima[s];
+		struct ProfileStats stats;
+		profile_stats(&stats, counts, h->sum, max);
+		fprintf(stdout, "%-11s %10llu %10.1f %10.1f %10.1f %10.1f\n",
+		        profile_stage_names[s], (unsigned long long) stats.count,
+		        stats.p50, stats.p99, stats.max, stats.mean);
+	}
+}
+
+#endif // SPECTROGEN_PROFILE
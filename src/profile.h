@@ -0,0 +1,216 @@
+#ifndef SPECTROGEN__PROFILE_H_
+#define SPECTROGEN__PROFILE_H_
+
+/*
+ * Instrumentation of the live pipeline. Define SPECTROGEN_PROFILE to time
+ * every stage of the calculation and render threads. Otherwise the PROFILE_*
+ * macros expand to nothing and no field or function of this header exists.
+ * Like SPECTROGEN_SINGLE_PRECISION, it must be defined consistently for every
+ * translation unit.
+ */
+#ifdef SPECTROGEN_PROFILE
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <SDL2/SDL.h>
+
+enum ProfileStage
+{
+	/**
+	 * Calculation thread: Waiting for the audio callback to capture a hop
+	 */
+	PROFILE_SAMPLE_WAIT,
+	/**
+	 * Calculation thread: Waiting in Display_pictQueue_write
+	 */
+	PROFILE_QUEUE_WAIT,
+	/**
+	 * Calculation thread: Copying the samples out of the history
+	 */
+	PROFILE_SNAPSHOT,
+	/**
+	 * Transforming the new columns. One time per share of a frame, so a frame
+	 * split between n threads counts n times.
+	 */
+	PROFILE_FFT,
+	/**
+	 * Power spectra, frequency layout and colouring of the new columns.
+	 * Counted per share like PROFILE_FFT.
+	 */
+	PROFILE_SHADE,
+	/**
+	 * Calculation thread: Unwrapping the ring of columns into the picture
+	 */
+	PROFILE_UNWRAP,
+	/**
+	 * Render thread: SDL_UpdateYUVTexture, or SDL_UnlockTexture in zero copy
+	 * mode
+	 */
+	PROFILE_UPLOAD,
+	/**
+	 * Render thread: Copying the texture onto the renderer and presenting it
+	 */
+	PROFILE_PRESENT,
+	PROFILE_STAGE_COUNT
+};
+
+/*
+ * Durations are counted in buckets of 8 per power of 2 of
+ * SDL_GetPerformanceCounter ticks, which bounds the error of a percentile to
+ * 12.5%. Durations below 8 ticks have a bucket each.
+ */
+#define PROFILE_SUB_BUCKETS 8
+#define PROFILE_BUCKETS (62 * PROFILE_SUB_BUCKETS)
+
+/**
+ * A lock-free histogram of durations. Any thread may record into it.
+ */
+struct ProfileHistogram
+{
+	_Atomic uint64_t counts[PROFILE_BUCKETS];
+	/**
+	 * Sum of the durations in ticks
+	 */
+	_Atomic uint64_t sum;
+	/**
+	 * Longest duration since the last Profile_update
+	 */
+	_Atomic uint64_t max;
+};
+/**
+ * Summary of a histogram in microseconds
+ */
+struct ProfileStats
+{
+	uint64_t count;
+	double p50, p99, max, mean;
+};
+
+struct Profile
+{
+	/**
+	 * Draw the statistics over the picture. Render thread only.
+	 */
+	bool overlay;
+	/**
+	 * Milliseconds between two updates of the statistics
+	 */
+	uint32_t period;
+
+	// Populated by Profile_init
+	/**
+	 * One histogram per stage. The counts are never reset.
+	 */
+	struct ProfileHistogram* histograms;
+	// The rest is owned by the render thread
+	/**
+	 * Counts and sums of the histograms at the last update
+	 */
+	uint64_t (*previous)[PROFILE_BUCKETS];
+	uint64_t previousSums[PROFILE_STAGE_COUNT];
+	/**
+	 * Longest durations up to the last update
+	 */
+	uint64_t maxima[PROFILE_STAGE_COUNT];
+	/**
+	 * Statistics over the last period
+	 */
+	struct ProfileStats stats[PROFILE_STAGE_COUNT];
+	double fps;
+	size_t queueDepth;
+	uint32_t timeStart, lastUpdate;
+	size_t lastFrames;
+	/**
+	 * Set by Profile_open
+	 */
+	FILE* dump;
+	bool json;
+};
+
+/**
+ * Must be called after period is initialised. 0 is treated as 1000.
+ */
+void Profile_init(struct Profile* const);
+void Profile_destroy(struct Profile* const);
+/**
+ * @brief Appends the statistics of every period to a file, as JSON with one
+ *  object per line if fileName ends with ".json", and as CSV otherwise.
+ * @return false if the file cannot be opened. The error is printed to stderr.
+ */
+bool Profile_open(struct Profile* const, char const* const fileName);
+
+static inline uint64_t profile_now(void)
+{
+	return SDL_GetPerformanceCounter();
+}
+/**
+ * @brief Records a duration of stage. Does nothing if p is NULL.
+ */
+static inline void Profile_record(struct Profile* const p,
+                                  enum ProfileStage stage, uint64_t ticks)
+{
+	if (!p) return;
+	size_t bucket = ticks;
+	if (ticks >= PROFILE_SUB_BUCKETS)
+	{
+		// 3 == log2(PROFILE_SUB_BUCKETS)
+		int const exponent = 63 - __builtin_clzll(ticks);
+		bucket = (exponent - 2) * PROFILE_SUB_BUCKETS +
+		         ((ticks >> (exponent - 3)) & (PROFILE_SUB_BUCKETS - 1));
+	}
+	struct ProfileHistogram* const h = &p->histograms[stage];
+	atomic_fetch_add_explicit(&h->counts[bucket], 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&h->sum, ticks, memory_order_relaxed);
+	uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+	while (ticks > max &&
+	       !atomic_compare_exchange_weak_explicit(&h->max, &max, ticks,
+	                                              memory_order_relaxed,
+	                                              memory_order_relaxed));
+}
+
+/**
+ * Render thread only
+ * @brief Recomputes the statistics and writes them to the dump once every
+ *  period
+ * @param nFramesDrawn Total number of frames drawn, for the frame rate
+ * @param queueDepth Number of pictures waiting to be drawn
+ */
+void Profile_update(struct Profile* const,
+                    size_t nFramesDrawn, size_t queueDepth);
+/**
+ * Render thread only
+ * @brief Draws the statistics of the last period onto the renderer if
+ *  overlay is set
+ */
+void Profile_draw(struct Profile* const, SDL_Renderer* const);
+/**
+ * @brief Prints the statistics of every stage since Profile_init
+ */
+void Profile_report(struct Profile* const);
+
+/*
+ * PROFILE_TIME(t) declares t as the current time. PROFILE_RECORD records the
+ * time elapsed since t. PROFILE_COUNTER declares an accumulator of ticks,
+ * PROFILE_ADD adds t1 - t0 to it and PROFILE_RECORD_TICKS records it.
+ */
+#define PROFILE_TIME(t) uint64_t const t = profile_now()
+#define PROFILE_RECORD(p, stage, t) \
+	Profile_record(p, stage, profile_now() - (t))
+#define PROFILE_COUNTER(x) uint64_t x = 0
+#define PROFILE_ADD(x, t0, t1) ((x) += (t1) - (t0))
+#define PROFILE_RECORD_TICKS(p, stage, x) Profile_record(p, stage, x)
+
+#else
+
+#define PROFILE_TIME(t)
+#define PROFILE_RECORD(p, stage, t) ((void) 0)
+#define PROFILE_COUNTER(x)
+#define PROFILE_ADD(x, t0, t1) ((void) 0)
+#define PROFILE_RECORD_TICKS(p, stage, x) ((void) 0)
+
+#endif // SPECTROGEN_PROFILE
+
+#endif // !SPECTROGEN__PROFILE_H_
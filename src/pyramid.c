@@ -0,0 +1,205 @@
+#include "pyramid.h"
+
+#include <assert.h>
+#include <tgmath.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Stamp of the tiles being computed, which cannot be evicted
+ */
+#define PYRAMID_PINNED UINT64_MAX
+
+void SpectrogramPyramid_init(struct SpectrogramPyramid* const p,
+                             struct DSTFT const* const dstft)
+{
+	assert(p && p->source);
+	assert(p->hop >= 1);
+	p->windowRadius = dstft->windowRadius;
+	assert(!p->rows || p->rows->constantQ);
+	p->stride = p->rows ? (size_t) p->rows->height : p->windowRadius + 1;
+
+	// Halve the columns until a level fits in one tile
+	size_t nColumns = (p->source->nSamples + p->hop - 1) / p->hop;
+	p->nLevels = 1;
+	for (size_t n = nColumns; n > PYRAMID_TILE_WIDTH; n = (n + 1) / 2)
+		++p->nLevels;
+	assert(p->maxTiles > (size_t) p->nLevels);
+
+	p->nColumns = malloc(sizeof(size_t) * p->nLevels);
+	p->nTiles = malloc(sizeof(size_t) * p->nLevels);
+	p->tiles = malloc(sizeof(struct PyramidTile*) * p->nLevels);
+	for (int l = 0; l < p->nLevels; ++l)
+	{
+		p->nColumns[l] = nColumns;
+		p->nTiles[l] = (nColumns + PYRAMID_TILE_WIDTH - 1) / PYRAMID_TILE_WIDTH;
+		p->tiles[l] = calloc(p->nTiles[l], sizeof(struct PyramidTile));
+		nColumns = (nColumns + 1) / 2;
+	}
+	p->nCached = 0;
+	p->clock = 0;
+	p->nTransformed = p->nPooled = 0;
+}
+void SpectrogramPyramid_destroy(struct SpectrogramPyramid* const p)
+{
+	if (!p) return;
+	for (int l = 0; l < p->nLevels; ++l)
+	{
+		for (size_t i = 0; i < p->nTiles[l]; ++i)
+			free(p->tiles[l][i].power);
+		free(p->tiles[l]);
+	}
+	free(p->tiles);
+	free(p->nColumns);
+	free(p->nTiles);
+}
+
+/**
+ * @brief Releases the least recently used tile
+ */
+static void pyramid_evict(struct SpectrogramPyramid* const p)
+{
+	struct PyramidTile* victim = NULL;
+	for (int l = 0; l < p->nLevels; ++l)
+	{
+		for (size_t i = 0; i < p->nTiles[l]; ++i)
+		{
+			struct PyramidTile* const tile = &p->tiles[l][i];
+			if (tile->power && (!victim || tile->lastUse < victim->lastUse))
+				victim = tile;
+		}
+	}
+	assert(victim && victim->lastUse != PYRAMID_PINNED);
+	free(victim->power);
+	victim->power = NULL;
+	--p->nCached;
+}
+/**
+ * @brief Fetches the i-th tile of level, computing it if it is not cached.
+ *  The result is valid until the next call.
+ */
+static real const* pyramid_tile(struct SpectrogramPyramid* const p,
+                                int level, size_t i,
+                                struct DSTFT* const dstfts, size_t nThreads)
+{
+	struct PyramidTile* const tile = &p->tiles[level][i];
+	if (tile->power)
+	{
+		tile->lastUse = ++p->clock;
+		return tile->power;
+	}
+
+	size_t const stride = p->stride;
+	if (p->nCached >= p->maxTiles) pyramid_evict(p);
+	tile->power = malloc(sizeof(real) * PYRAMID_TILE_WIDTH * stride);
+	tile->lastUse = PYRAMID_PINNED;
+	++p->nCached;
+
+	size_t const first = i * PYRAMID_TILE_WIDTH;
+	size_t n = p->nColumns[level] - first;
+	if (n > PYRAMID_TILE_WIDTH) n = PYRAMID_TILE_WIDTH;
+	if (level == 0)
+	{
+		size_t centres[PYRAMID_TILE_WIDTH];
+		for (size_t k = 0; k < n; ++k)
+			centres[k] = (first + k) * p->hop;
+		if (p->rows)
+			spectrogram_amplitude_columns(tile->power, p->source, centres, n,
+			                              p->rows, dstfts, nThreads);
+		else
+			spectrogram_power_columns(tile->power, p->source, centres, n,
+			                          dstfts, nThreads);
+		++p->nTransformed;
+	}
+	else
+	{
+		// Each half of the tile pools one tile of the level below
+		for (size_t h = 0; h < 2; ++h)
+		{
+			size_t const child = 2 * i + h;
+			if (child >= p->nTiles[level - 1]) break;
+			real const* const below =
+			  pyramid_tile(p, level - 1, child, dstfts, nThreads);
+			size_t nBelow = p->nColumns[level - 1] - child * PYRAMID_TILE_WIDTH;
+			if (nBelow > PYRAMID_TILE_WIDTH) nBelow = PYRAMID_TILE_WIDTH;
+
+			for (size_t c = 0; 2 * c < nBelow; ++c)
+			{
+				real* const out =
+				  tile->power + (h * PYRAMID_TILE_WIDTH / 2 + c) * stride;
+				real const* const left = below + 2 * c * stride;
+				if (2 * c + 1 == nBelow)
+				{
+					memcpy(out, left, sizeof(real) * stride);
+					continue;
+				}
+				real const* const right = left + stride;
+				for (size_t j = 0; j < stride; ++j)
+					out[j] = left[j] > right[j] ? left[j] : right[j];
+			}
+		}
+		++p->nPooled;
+	}
+	tile->lastUse = ++p->clock;
+	return tile->power;
+}
+
+void SpectrogramPyramid_render(struct SpectrogramPyramid* const p,
+                               struct SpectrogramImage const* const image,
+                               int width, real begin, real scale,
+                               struct FrequencyLayout const* const layout,
+                               struct ColourGradient const* const grad,
+                               struct DSTFT* const dstfts, size_t nThreads)
+{
+	assert(scale > 0);
+	assert(layout->windowRadius == p->windowRadius);
+	assert(!p->rows || p->rows == layout);
+	size_t const stride = p->stride;
+	int const height = layout->height;
+
+	// The coarsest level with at least one column per pixel
+	int level = scale >= 1 ? (int) floor(log2(scale)) : 0;
+	if (level >= p->nLevels) level = p->nLevels - 1;
+	real const factor = (real) ((size_t) 1 << level);
+	begin /= factor;
+	scale /= factor;
+
+	real* const amplitudes = malloc(sizeof(real) * width * height);
+	real* const power = malloc(sizeof(real) * stride);
+	for (int x = 0; x < width; ++x)
+	{
+		real* const column = amplitudes + x * height;
+		real const low = begin + x * scale;
+		real const high = low + scale;
+		if (high <= 0 || low >= p->nColumns[level])
+		{
+			for (int row = 0; row < height; ++row)
+				column[row] = -INFINITY;
+			continue;
+		}
+		// The columns [c0, c1) of the level cover the pixel
+		size_t const c0 = low > 0 ? (size_t) low : 0;
+		size_t c1 = (size_t) ceil(high);
+		if (c1 <= c0) c1 = c0 + 1;
+		if (c1 > p->nColumns[level]) c1 = p->nColumns[level];
+
+		for (size_t c = c0; c < c1; ++c)
+		{
+			real const* const tile = pyramid_tile(p, level, c / PYRAMID_TILE_WIDTH,
+			                                      dstfts, nThreads);
+			real const* const in = tile + (c % PYRAMID_TILE_WIDTH) * stride;
+			if (c == c0)
+			{
+				memcpy(power, in, sizeof(real) * stride);
+				continue;
+			}
+			for (size_t j = 0; j < stride; ++j)
+				if (in[j] > power[j]) power[j] = in[j];
+		}
+		if (p->rows) memcpy(column, power, sizeof(real) * height);
+		else FrequencyLayout_eval(layout, column, power);
+	}
+	spectrogram_shade_columns(image, amplitudes, height, width, grad);
+	free(amplitudes);
+	free(power);
+}
@@ -0,0 +1,93 @@
+#ifndef SPECTROGEN__PYRAMID_H_
+#define SPECTROGEN__PYRAMID_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fourier.h"
+#include "gradient.h"
+#include "layout.h"
+#include "samplesource.h"
+#include "spectrogram.h"
+
+/**
+ * Number of columns in a tile
+ */
+#define PYRAMID_TILE_WIDTH 256
+
+struct PyramidTile
+{
+	/**
+	 * PYRAMID_TILE_WIDTH columns of stride reals, see SpectrogramPyramid.
+	 * NULL if the tile is not cached.
+	 */
+	real* power;
+	uint64_t lastUse;
+};
+
+/**
+ * Power spectra of a sample source at several time resolutions. Level 0 has
+ * a column every hop samples. Each column of level l + 1 is the component-wise
+ * maximum of two adjacent columns of level l. The levels are split into tiles
+ * which are computed on first use and evicted least recently used first.
+ *
+ * Constant-Q rows need the phase of the spectrum, so with a constant-Q layout
+ * the columns hold the log amplitudes of its rows instead. The logarithm is
+ * increasing, so pooling them by maximum pools the row powers.
+ */
+struct SpectrogramPyramid
+{
+	struct SampleSource const* source;
+	size_t hop;
+	/**
+	 * Maximum number of cached tiles. Must exceed the number of levels.
+	 */
+	size_t maxTiles;
+	/**
+	 * A layout on AXIS_CONSTANT_Q whose rows are stored, or NULL to store
+	 * power spectra. Every render must use this layout.
+	 */
+	struct FrequencyLayout const* rows;
+
+	// Populated by SpectrogramPyramid_init
+	size_t windowRadius;
+	/**
+	 * Number of reals per column: windowRadius + 1, or the height of rows
+	 */
+	size_t stride;
+	int nLevels;
+	/**
+	 * Number of columns and tiles of each level
+	 */
+	size_t* nColumns;
+	size_t* nTiles;
+	struct PyramidTile** tiles;
+	size_t nCached;
+	uint64_t clock;
+	/**
+	 * Number of tiles computed so far, by transform or by pooling
+	 */
+	size_t nTransformed, nPooled;
+};
+
+/**
+ * Must be called after source, hop, maxTiles and rows are initialised
+ */
+void SpectrogramPyramid_init(struct SpectrogramPyramid* const,
+                             struct DSTFT const* const);
+void SpectrogramPyramid_destroy(struct SpectrogramPyramid* const);
+/**
+ * @brief Shades width columns of the level 0 column range
+ *  [begin, begin + width * scale) into image. Columns past the end of the
+ *  source are blank.
+ * @param[in] scale Number of level 0 columns per column of the image
+ * @param dstfts An array of nThreads workspaces, computing missing tiles
+ */
+void SpectrogramPyramid_render(struct SpectrogramPyramid* const,
+                               struct SpectrogramImage const* const image,
+                               int width, real begin, real scale,
+                               struct FrequencyLayout const* const,
+                               struct ColourGradient const* const,
+                               struct DSTFT* const dstfts, size_t nThreads);
+
+#endif // !SPECTROGEN__PYRAMID_H_
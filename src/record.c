@@ -1,17 +1,98 @@
 #include "record.h"
 
+#include <stdatomic.h>
+
 #include <portaudio.h>
 
 #include "spectrogram.h"
 
+/**
+ * Number of captured samples filtered at once by the callback
+ */
+#define RECORD_ZOOM_BLOCK 256
+
+/**
+ * A single producer ring buffer holding the history of captured samples.
+ * The audio callback only appends, and publishes the samples by advancing
+ * end. Readers copy a window by absolute index. See SampleArray_snapshot.
+ */
 struct SampleArray
 {
-	real* samples;
+	/**
+	 * The sample of absolute index i is stored at ring[i & (capacity - 1)]
+	 */
+	real* ring;
+	/**
+	 * A power of 2 no less than 2 * nSamples. The extra space lets a reader
+	 * finish copying while the callback keeps appending.
+	 */
+	size_t capacity;
+	/**
+	 * Number of samples in the history
+	 */
 	size_t nSamples;
-	SDL_mutex* mutex;
+	/**
+	 * Absolute index of the sample after the newest one. The history
+	 * initially holds nSamples samples of silence.
+	 */
+	_Atomic size_t end;
 	_Atomic bool paused;
+	/**
+	 * If not NULL, the history holds the output of zoom. Only the callback
+	 * uses it.
+	 */
+	struct ZoomFilter* zoom;
+
+	/*
+	 * The calculation thread sleeps on newSamples until end reaches wakeAt.
+	 * waiting is set while the calculation thread expects a post, so the
+	 * callback posts at most once per wait however many times it runs.
+	 */
+	SDL_sem* newSamples;
+	_Atomic size_t wakeAt;
+	_Atomic bool waiting;
 };
 
+/**
+ * @brief Copies the samples from the absolute index begin up to the newest
+ *  sample, clamped to the history.
+ * @param[out] out An array of size sa->nSamples
+ * @param[out] end Absolute index of the sample after out[n - 1]
+ * @param[in] minimum Minimum number of samples to copy. Cannot exceed
+ *  sa->nSamples.
+ * @return n, the number of samples copied
+ */
+static size_t SampleArray_snapshot(struct SampleArray* const sa,
+                                   real* const out, size_t begin,
+                                   size_t minimum, size_t* const end)
+{
+	size_t const mask = sa->capacity - 1;
+	while (true)
+	{
+		size_t const e = atomic_load_explicit(&sa->end, memory_order_acquire);
+		if (begin + sa->nSamples < e) begin = e - sa->nSamples;
+		if (begin + minimum > e) begin = e - minimum;
+		size_t const n = e - begin;
+
+		size_t const i = begin & mask;
+		size_t const n0 = n < sa->capacity - i ? n : sa->capacity - i;
+		memcpy(out, sa->ring + i, sizeof(real) * n0);
+		memcpy(out + n0, sa->ring, sizeof(real) * (n - n0));
+
+		/*
+		 * The copy is valid unless the callback has wrapped around onto it. A
+		 * callback in progress may be writing up to nSamples samples past e1.
+		 */
+		atomic_thread_fence(memory_order_acquire);
+		size_t const e1 = atomic_load_explicit(&sa->end, memory_order_relaxed);
+		if (e1 - begin + sa->nSamples <= sa->capacity)
+		{
+			*end = e;
+			return n;
+		}
+	}
+}
+
 // This function's signature matches Pa_StreamCallback
 int record_callback(float const* input, void* output, unsigned long nFrames,
                     PaStreamCallbackTimeInfo const* timeInfo,
@@ -23,103 +104,193 @@ int record_callback(float const* input, void* output, unsigned long nFrames,
 	(void) flags;
 
 	if (sa->paused) return paContinue;
-	
-	SDL_LockMutex(sa->mutex);
-	if (nFrames >= sa->nSamples)
+
+	// Only the callback modifies end
+	size_t end = atomic_load_explicit(&sa->end, memory_order_relaxed);
+	size_t const mask = sa->capacity - 1;
+	if (sa->zoom)
 	{
-		for (size_t i = 0; i < sa->nSamples; ++i)
-			sa->samples[i] = (real) input[i + nFrames - sa->nSamples];
+		/*
+		 * Published one block at a time, so that no more than nSamples samples
+		 * are ever written past the published end
+		 */
+		size_t const block = RECORD_ZOOM_BLOCK < sa->nSamples ?
+		                     RECORD_ZOOM_BLOCK : sa->nSamples;
+		real in[block];
+		real out[block];
+		for (size_t i = 0; i < nFrames; i += block)
+		{
+			size_t const n = nFrames - i < block ? nFrames - i : block;
+			for (size_t k = 0; k < n; ++k)
+				in[k] = (real) input[i + k];
+			size_t const nOut = ZoomFilter_process(sa->zoom, in, n, out);
+			for (size_t k = 0; k < nOut; ++k)
+				sa->ring[(end + k) & mask] = out[k];
+			end += nOut;
+			atomic_store_explicit(&sa->end, end, memory_order_release);
+		}
 	}
 	else
 	{
-		memmove(sa->samples, sa->samples + nFrames,
-		        sizeof(real) * (sa->nSamples - nFrames));
-		for (size_t i = 0; i < nFrames; ++i)
+		/*
+		 * Published at most nSamples samples at a time, as above. The host may
+		 * deliver buffers of any size.
+		 */
+		for (size_t i = 0; i < nFrames; i += sa->nSamples)
 		{
-			sa->samples[i + sa->nSamples - nFrames] = (real) input[i];
+			size_t const n = nFrames - i < sa->nSamples ? nFrames - i :
+			                 sa->nSamples;
+			for (size_t k = 0; k < n; ++k)
+				sa->ring[(end + k) & mask] = (real) input[i + k];
+			end += n;
+			atomic_store_explicit(&sa->end, end, memory_order_release);
 		}
 	}
-	SDL_UnlockMutex(sa->mutex);
 
+	if (end >= sa->wakeAt && atomic_exchange(&sa->waiting, false))
+		SDL_SemPost(sa->newSamples);
 
 	return paContinue;
 }
 
+/**
+ * @brief Blocks the current thread until the history reaches the absolute
+ *  index wakeAt
+ * @return false if d->quit is set to true
+ */
+static bool SampleArray_wait(struct SampleArray* const sa, size_t wakeAt,
+                             struct Display* const d)
+{
+	sa->wakeAt = wakeAt;
+	sa->waiting = true;
+	if (sa->end >= wakeAt && atomic_exchange(&sa->waiting, false))
+		return !d->quit;
+	/*
+	 * Either the callback has cleared waiting and will post, or it will post
+	 * once end reaches wakeAt. Wake up periodically to observe d->quit.
+	 */
+	while (SDL_SemWaitTimeout(sa->newSamples, 100) == SDL_MUTEX_TIMEDOUT)
+	{
+		if (d->quit) return false;
+	}
+	return !d->quit;
+}
+
 struct CalculationData
 {
 	struct SampleArray* sampleArray;
-	struct DSTFT* dstft;
+	struct DSTFT* dstfts;
+	size_t nThreads;
 	struct Display* display;
+	struct SpectrogramScroll* scroll;
+	/**
+	 * Minimum number of new samples before the spectrogram is redrawn
+	 */
+	size_t minHop;
 };
 int record_calculation_thread(struct CalculationData* const calculationData)
 {
 	struct Display* d = calculationData->display;
 	struct SampleArray* sa = calculationData->sampleArray;
-	struct DSTFT* dstft = calculationData->dstft;
+	struct DSTFT* dstfts = calculationData->dstfts;
+	size_t nThreads = calculationData->nThreads;
+	struct SpectrogramScroll* scroll = calculationData->scroll;
 
-	uint8_t* image = malloc(3 * d->width * d->height * sizeof(uint8_t));
-	uint8_t const* dataIn[3];
-	int linesizeIn[3];
-	uint8_t* dataOut[3];
-	int linesizeOut[3];
-	{
-		dataIn[0] = dataIn[1] = dataIn[2] = image;
-		linesizeIn[0] = linesizeIn[1] = linesizeIn[2] = d->width * 3;
-		size_t pitchUV = d->width / 2;
-		linesizeOut[0] = d->width;
-		linesizeOut[1] = pitchUV;
-		linesizeOut[2] = pitchUV;
-	}
-	while (Display_pictQueue_write(d))
+	real* samples = malloc(sizeof(real) * sa->nSamples);
+	size_t const radius = dstfts[0].windowRadius;
+
+	struct SpectrogramImage image;
+	image.format = SPECTROGRAM_YUV420P;
+	size_t end = sa->end;
+	while (true)
 	{
-		struct Picture* p = &d->pictQueue[d->pictQueueIW];
-		dataOut[0] = p->planeY;
-		dataOut[1] = p->planeU;
-		dataOut[2] = p->planeV;
-
-		// Populate image
-		SDL_LockMutex(sa->mutex);
-		spectrogram_populate(image, d->width, d->height,
-		                     sa->samples, sa->nSamples, true, &d->colourGradient,
-		                     dstft);
-		SDL_UnlockMutex(sa->mutex);
-
-		sws_scale(d->swsContext,
-		          dataIn, linesizeIn, 0, d->height,
-		          dataOut, linesizeOut);
-
-		++d->pictQueueIW;
-		if (d->pictQueueIW == DISPLAY_PICTQUEUE_SIZE_MAX)
-			d->pictQueueIW = 0;
-		SDL_LockMutex(d->pictQueueMutex);
-		++d->pictQueueSize;
-		SDL_UnlockMutex(d->pictQueueMutex);
+		PROFILE_TIME(timeSampleWait);
+		if (!SampleArray_wait(sa, end + calculationData->minHop, d)) break;
+		PROFILE_RECORD(&d->profile, PROFILE_SAMPLE_WAIT, timeSampleWait);
+		PROFILE_TIME(timeQueueWait);
+		struct Picture* p = Display_pictQueue_write(d);
+		if (!p) break;
+		PROFILE_RECORD(&d->profile, PROFILE_QUEUE_WAIT, timeQueueWait);
+		image.planes[0] = p->planeY;
+		image.planes[1] = p->planeU;
+		image.planes[2] = p->planeV;
+		image.pitches[0] = p->pitchY;
+		image.pitches[1] = image.pitches[2] = p->pitchUV;
+
+		/*
+		 * Only the samples from the window of the next column onwards are
+		 * needed to transform the new columns.
+		 */
+		size_t const begin = scroll->nextCentre > radius ?
+		                     scroll->nextCentre - radius : 0;
+		PROFILE_TIME(timeSnapshot);
+		size_t nSamples = SampleArray_snapshot(sa, samples, begin,
+		                                       dstfts[0].windowWidth, &end);
+		PROFILE_RECORD(&d->profile, PROFILE_SNAPSHOT, timeSnapshot);
 
+		// Transform the new columns and render them into the picture
+		SpectrogramScroll_update(scroll, samples, nSamples, end,
+		                         &d->frequencyLayout, &d->colourGradient,
+		                         dstfts, nThreads);
+		PROFILE_TIME(timeUnwrap);
+		SpectrogramScroll_render(scroll, &image);
+		PROFILE_RECORD(&d->profile, PROFILE_UNWRAP, timeUnwrap);
+
+		Display_pictQueue_push(d);
 	}
 
-	free(image);
+	free(samples);
 	return 0;
 }
-void record_exec(struct Display* const d, struct DSTFT* const dstft,
-			size_t nSamples)
+void record_exec(struct Display* const d,
+                 struct DSTFT* const dstfts, size_t nThreads,
+                 size_t nSamples, size_t minHop, bool sliding,
+                 struct ZoomFilter* const zoom)
 {
-	(void) d;
-	(void) dstft;
-
+	struct SlidingDFT slidingDFT;
+	if (sliding && !SlidingDFT_init(&slidingDFT, &dstfts[0], &d->frequencyLayout))
+	{
+		fprintf(stderr, "The sliding DFT requires the 'rect' or 'expc' window\n");
+		return;
+	}
 	fprintf(stdout, "Recording spectrogram\n");
 
 
 	struct SampleArray sa;
 	sa.nSamples = nSamples; // 2 secs
-	sa.samples = calloc(sizeof(real), sa.nSamples);
-	sa.mutex = SDL_CreateMutex();
+	sa.capacity = 1;
+	while (sa.capacity < 2 * sa.nSamples) sa.capacity *= 2;
+	sa.ring = calloc(sizeof(real), sa.capacity);
+	sa.end = sa.nSamples;
 	sa.paused = false;
+	sa.zoom = zoom;
+	sa.newSamples = SDL_CreateSemaphore(0);
+	sa.wakeAt = 0;
+	sa.waiting = false;
+
+	/*
+	 * Each column advances by a fixed hop so the whole history, less the
+	 * window, spans the width of the display.
+	 */
+	struct SpectrogramScroll scroll;
+	scroll.width = d->width;
+	scroll.height = d->height;
+	scroll.hop = (nSamples - dstfts[0].windowWidth) / d->width;
+	if (scroll.hop == 0) scroll.hop = 1;
+	scroll.format = SPECTROGRAM_YUV420P;
+	SpectrogramScroll_init(&scroll);
+	if (sliding) scroll.sliding = &slidingDFT;
+#ifdef SPECTROGEN_PROFILE
+	scroll.profile = &d->profile;
+#endif
+	if (minHop == 0) minHop = scroll.hop;
 
+	SDL_Thread* calculationThread = NULL;
 	int paError = Pa_Initialize();
 	if (paError != paNoError)
 	{
 		fprintf(stderr, "[PortAudio] %s\n", Pa_GetErrorText(paError));
-		return;
+		goto release;
 	}
 
 	PaStreamParameters params;
@@ -138,7 +309,7 @@ void record_exec(struct Display* const d, struct DSTFT* const dstft,
 	            &stream,
 	            &params,
 	            NULL,
-	            48000, // Sample rate
+	            RECORD_SAMPLE_RATE,
 	            paFramesPerBufferUnspecified, // Frame/Buffer
 	            paClipOff,
 	            (PaStreamCallback*) record_callback,
@@ -150,28 +321,36 @@ void record_exec(struct Display* const d, struct DSTFT* const dstft,
 	struct CalculationData calculationData;
 	calculationData.display = d;
 	calculationData.sampleArray = &sa;
-	calculationData.dstft = dstft;
-	SDL_CreateThread((SDL_ThreadFunction) record_calculation_thread,
-	                 "calculation", &calculationData);
+	calculationData.dstfts = dstfts;
+	calculationData.nThreads = nThreads;
+	calculationData.scroll = &scroll;
+	calculationData.minHop = minHop;
+	calculationThread =
+	  SDL_CreateThread((SDL_ThreadFunction) record_calculation_thread,
+	                   "calculation", &calculationData);
 
 	
-	schedule_refresh(d, 40);
 	while ((paError = Pa_IsStreamActive(stream)) == 1)
 	{
+		/*
+		 * Sleep until an event arrives or the next picture is due. The stream
+		 * is checked at least every 100 ms.
+		 */
+		int timeout = Display_present(d);
+		if (timeout < 0 || timeout > 100) timeout = 100;
 		SDL_Event event;
-		if (SDL_PollEvent(&event) == 0)
+		if (SDL_WaitEventTimeout(&event, timeout) == 0)
 			continue;
 
 		switch (event.type)
 		{
 		case SDL_QUIT:
 			d->quit = true;
-			sa.paused = false;
 			paError = Pa_CloseStream(stream);
 			goto complete;
 			break;
-		case EVENT_REFRESH:
-			refresh(event.user.data1);
+		case EVENT_FRAME_READY:
+			// Drawn by Display_present
 			break;
 		case SDL_KEYDOWN:
 			switch(event.key.keysym.sym)
@@ -179,6 +358,11 @@ void record_exec(struct Display* const d, struct DSTFT* const dstft,
 			case SDLK_SPACE:
 				sa.paused = !sa.paused;
 				break;
+#ifdef SPECTROGEN_PROFILE
+			case SDLK_o:
+				d->profile.overlay = !d->profile.overlay;
+				break;
+#endif
 			}
 			break;
 		default:
@@ -194,6 +378,16 @@ complete:
 		fprintf(stderr, "[PortAudio] %s\n", Pa_GetErrorText(paError));
 	}
 	Pa_Terminate();
-	SDL_DestroyMutex(sa.mutex);
-	free(sa.samples);
+	if (calculationThread)
+	{
+		d->quit = true;
+		SDL_SemPost(sa.newSamples);
+		SDL_WaitThread(calculationThread, NULL);
+	}
+	Display_pictQueue_report(d);
+release:
+	SDL_DestroySemaphore(sa.newSamples);
+	free(sa.ring);
+	SpectrogramScroll_destroy(&scroll);
+	if (sliding) SlidingDFT_destroy(&slidingDFT);
 }
@@ -5,10 +5,28 @@
 
 #include "fourier.h"
 #include "display.h"
+#include "zoomfilter.h"
+
+/**
+ * Sample rate of the microphone in Hz
+ */
+#define RECORD_SAMPLE_RATE 48000
 
 /**
  * Start recording audio and display the spectrogram in real time
+ * @param dstfts An array of nThreads workspaces, one per calculation thread
+ * @param minHop Minimum number of new samples before the spectrogram is
+ *  redrawn. 0 redraws once per column.
+ * @param sliding Update the displayed components per sample with a sliding
+ *  DFT instead of transforming each column. Requires the rectangular or the
+ *  exponential causal window.
+ * @param zoom If not NULL, the captured samples pass through zoom before they
+ *  are stored, and nSamples, minHop and the window count decimated samples.
+ *  zoom must be initialised with RECORD_SAMPLE_RATE.
  */
-void record_exec(struct Display* const, struct DSTFT* const, size_t nSamples);
+void record_exec(struct Display* const,
+                 struct DSTFT* const dstfts, size_t nThreads,
+                 size_t nSamples, size_t minHop, bool sliding,
+                 struct ZoomFilter* const zoom);
 
 #endif // !SPECTROGEN__RECORD_H_
@@ -0,0 +1,702 @@
+#include "samplesource.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static size_t sample_format_width(enum SampleFormat format)
+{
+	switch (format)
+	{
+	case SAMPLE_S16LE: return 2;
+	case SAMPLE_S24LE: return 3;
+	case SAMPLE_F32LE: return 4;
+	default: return sizeof(real);
+	}
+}
+static uint32_t read_u32le(uint8_t const* const p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+static uint16_t read_u16le(uint8_t const* const p)
+{
+	return p[0] | p[1] << 8;
+}
+
+void SampleSource_init_array(struct SampleSource* const s,
+                             real const* const samples, size_t nSamples)
+{
+	assert(s);
+	memset(s, 0, sizeof(struct SampleSource));
+	s->format = SAMPLE_REAL;
+	s->data = samples;
+	s->stride = sizeof(real);
+	s->nSamples = nSamples;
+}
+
+static bool is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+/**
+ * @brief Parses a number spanning [begin, end) apart from surrounding white
+ *  space, in any form strtod accepts. Decimal numbers that are exact in double
+ *  precision with at most 19 significant digits and a decimal exponent of at
+ *  most 22 are converted without strtod.
+ * @return false if the text is not a number
+ */
+static bool parse_real(char const* begin, char const* end, real* const out)
+{
+	while (begin < end && is_space(*begin)) ++begin;
+	while (end > begin && is_space(end[-1])) --end;
+	if (begin == end) return false;
+
+	static double const powers[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	char const* p = begin;
+	bool negative = false;
+	if (*p == '-' || *p == '+') negative = *p++ == '-';
+
+	uint64_t mantissa = 0;
+	int nDigits = 0, exponent = 0;
+	bool hasDigits = false;
+	for (; p < end && *p >= '0' && *p <= '9'; ++p)
+	{
+		hasDigits = true;
+		if (nDigits == 0 && *p == '0') continue;
+		if (nDigits++ < 19) mantissa = mantissa * 10 + (*p - '0');
+		else ++exponent;
+	}
+	if (p < end && *p == '.')
+	{
+		for (++p; p < end && *p >= '0' && *p <= '9'; ++p)
+		{
+			hasDigits = true;
+			if (nDigits == 0 && *p == '0')
+			{
+				--exponent;
+				continue;
+			}
+			if (nDigits++ < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				--exponent;
+			}
+		}
+	}
+	if (!hasDigits) goto slow;
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		++p;
+		bool negativeExp = false;
+		if (p < end && (*p == '-' || *p == '+')) negativeExp = *p++ == '-';
+		if (p == end || *p < '0' || *p > '9') goto slow;
+		int e = 0;
+		for (; p < end && *p >= '0' && *p <= '9'; ++p)
+			if (e < 100000) e = e * 10 + (*p - '0');
+		exponent += negativeExp ? -e : e;
+	}
+	if (p != end) goto slow;
+
+	if (nDigits <= 19 && mantissa < ((uint64_t) 1 << 53) &&
+	    exponent >= -22 && exponent <= 22)
+	{
+		double x = (double) mantissa;
+		x = exponent < 0 ? x / powers[-exponent] : x * powers[exponent];
+		*out = negative ? -x : x;
+		return true;
+	}
+
+slow:
+	// Long mantissas, large exponents, hexadecimal, inf and nan
+	{
+		// strtod needs a terminated copy, allocated for long tokens
+		char buffer[64];
+		size_t const length = end - begin;
+		char* const token = length < sizeof(buffer) ? buffer :
+		                    malloc(length + 1);
+		if (!token) return false;
+		memcpy(token, begin, length);
+		token[length] = '\0';
+		char* tokenEnd;
+		double x = strtod(token, &tokenEnd);
+		bool const valid = tokenEnd == token + length;
+		if (token != buffer) free(token);
+		if (!valid) return false;
+		*out = x;
+		return true;
+	}
+}
+
+/**
+ * @brief Parses the sample count on the first line of the text format
+ */
+static bool parse_count(char const* p, char const* const end,
+                        size_t* const out)
+{
+	size_t n = 0;
+	while (p < end && is_space(*p)) ++p;
+	char const* const digits = p;
+	for (; p < end && *p >= '0' && *p <= '9'; ++p)
+	{
+		if (n > SIZE_MAX / sizeof(real) / 10) return false;
+		n = n * 10 + (*p - '0');
+	}
+	while (p < end && is_space(*p)) ++p;
+	if (p == digits || p != end) return false;
+	*out = n;
+	return true;
+}
+
+/**
+ * A block of whole lines of a text file
+ */
+struct TextChunk
+{
+	char const* begin;
+	char const* end;
+	/**
+	 * Number of lines in the chunk, then index of its first line
+	 */
+	size_t nLines;
+	size_t firstLine;
+	/**
+	 * Lines from index nMax on are not decoded
+	 */
+	size_t nMax;
+	real* samples;
+	/**
+	 * Index of the first line that is not a number, or SIZE_MAX
+	 */
+	size_t badLine;
+};
+static int TextChunk_count(struct TextChunk* const c)
+{
+	size_t n = 0;
+	for (char const* p = c->begin; p < c->end; ++n)
+	{
+		char const* const eol = memchr(p, '\n', c->end - p);
+		p = eol ? eol + 1 : c->end;
+	}
+	c->nLines = n;
+	return 0;
+}
+static int TextChunk_parse(struct TextChunk* const c)
+{
+	c->badLine = SIZE_MAX;
+	char const* p = c->begin;
+	for (size_t i = c->firstLine; i < c->firstLine + c->nLines && i < c->nMax; ++i)
+	{
+		char const* eol = memchr(p, '\n', c->end - p);
+		if (!eol) eol = c->end;
+		if (!parse_real(p, eol, &c->samples[i]))
+		{
+			c->badLine = i;
+			return 0;
+		}
+		p = eol + 1;
+	}
+	return 0;
+}
+/**
+ * @brief Decodes the text format from the mapped file into s->decoded. The
+ *  lines are split into a chunk per thread of pool, decoded in parallel.
+ */
+static bool SampleSource_parse_text(struct SampleSource* const s,
+                                    struct WorkerPool* const pool)
+{
+	char const* const file = s->map;
+	char const* end = file + s->mapSize;
+	// Trailing blank lines are not samples
+	while (end > file && is_space(end[-1])) --end;
+
+	char const* const eol = memchr(file, '\n', end - file);
+	char const* const body = eol ? eol + 1 : end;
+	size_t nSamples;
+	if (!parse_count(file, body, &nSamples))
+	{
+		fprintf(stderr, "Line 1: Invalid number of samples\n");
+		return false;
+	}
+	real* const samples = malloc(sizeof(real) * (nSamples ? nSamples : 1));
+	if (!samples)
+	{
+		fprintf(stderr, "Unable to allocate %zu samples\n", nSamples);
+		return false;
+	}
+
+	// Chunk boundaries are moved past the next newline
+	size_t nThreads = pool ? pool->nThreads : 1;
+	size_t const size = end - body;
+	if (nThreads > size / 4096 + 1) nThreads = size / 4096 + 1;
+	struct TextChunk chunks[nThreads];
+	char const* begin = body;
+	for (size_t t = 0; t < nThreads; ++t)
+	{
+		char const* e = body + size * (t + 1) / nThreads;
+		if (e < begin) e = begin;
+		if (e < end)
+		{
+			char const* const nl = memchr(e, '\n', end - e);
+			e = nl ? nl + 1 : end;
+		}
+		chunks[t].begin = begin;
+		chunks[t].end = e;
+		chunks[t].nMax = nSamples;
+		chunks[t].samples = samples;
+		begin = e;
+	}
+	WorkerPool_exec(pool, (int (*)(void*)) TextChunk_count, chunks,
+	                sizeof(struct TextChunk), nThreads);
+	size_t nLines = 0;
+	for (size_t t = 0; t < nThreads; ++t)
+	{
+		chunks[t].firstLine = nLines;
+		nLines += chunks[t].nLines;
+	}
+	if (nLines < nSamples)
+	{
+		fprintf(stderr, "Sample numbers do not match: %zu declared, %zu found\n",
+		        nSamples, nLines);
+		free(samples);
+		return false;
+	}
+	if (nLines > nSamples)
+	{
+		fprintf(stderr, "Ignoring %zu samples after the declared %zu\n",
+		        nLines - nSamples, nSamples);
+	}
+
+	WorkerPool_exec(pool, (int (*)(void*)) TextChunk_parse, chunks,
+	                sizeof(struct TextChunk), nThreads);
+	for (size_t t = 0; t < nThreads; ++t)
+	{
+		if (chunks[t].badLine != SIZE_MAX)
+		{
+			// The sample of index i is on line i + 2
+			fprintf(stderr, "Line %zu: Invalid sample\n", chunks[t].badLine + 2);
+			free(samples);
+			return false;
+		}
+	}
+
+	munmap(s->map, s->mapSize);
+	SampleSource_init_array(s, samples, nSamples);
+	s->decoded = samples;
+	return true;
+}
+/**
+ * A file read by wav_parse, either mapped or read with pread
+ */
+struct WavFile
+{
+	uint8_t const* map;
+	int fd;
+	size_t size;
+};
+/**
+ * @brief Copies n bytes at offset of the file to out
+ * @return false if the file ends first or cannot be read
+ */
+static bool wav_read(struct WavFile const* const f, uint8_t* const out,
+                     size_t n, size_t offset)
+{
+	if (offset > f->size || n > f->size - offset) return false;
+	if (f->map)
+	{
+		memcpy(out, f->map + offset, n);
+		return true;
+	}
+	for (size_t done = 0; done < n;)
+	{
+		ssize_t const r = pread(f->fd, out + done, n - done, offset + done);
+		if (r <= 0) return false;
+		done += r;
+	}
+	return true;
+}
+/**
+ * @brief Locates the samples of the first channel in a RIFF WAVE file. Only
+ *  the chunk headers and the format are read, so chunks of any size may
+ *  precede the data.
+ * @param[out] s The format, stride and nSamples are populated
+ * @param[out] dataOffset Offset of the first sample in the file
+ */
+static bool wav_parse(struct WavFile const* const file,
+                      struct SampleSource* const s, size_t* const dataOffset)
+{
+	size_t const fileSize = file->size;
+	uint8_t riff[12];
+	if (!wav_read(file, riff, sizeof(riff), 0) || memcmp(riff, "RIFF", 4) ||
+	    memcmp(riff + 8, "WAVE", 4))
+	{
+		fprintf(stderr, "Not a RIFF WAVE file\n");
+		return false;
+	}
+
+	uint16_t tag = 0, nChannels = 0, blockAlign = 0, bits = 0;
+	bool hasFormat = false;
+	for (size_t offset = 12; offset + 8 <= fileSize;)
+	{
+		// The header and at most the 40 bytes of WAVE_FORMAT_EXTENSIBLE
+		uint8_t chunk[8 + 40];
+		if (!wav_read(file, chunk, 8, offset)) break;
+		size_t chunkSize = read_u32le(chunk + 4);
+		offset += 8;
+		if (memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16 &&
+		    offset + chunkSize <= fileSize)
+		{
+			if (!wav_read(file, chunk + 8, chunkSize < 40 ? chunkSize : 40,
+			              offset))
+				break;
+			tag = read_u16le(chunk + 8);
+			nChannels = read_u16le(chunk + 10);
+			blockAlign = read_u16le(chunk + 20);
+			bits = read_u16le(chunk + 22);
+			// WAVE_FORMAT_EXTENSIBLE stores the tag in its sub format
+			if (tag == 0xFFFE && chunkSize >= 40)
+				tag = read_u16le(chunk + 32);
+			hasFormat = true;
+		}
+		else if (memcmp(chunk, "data", 4) == 0)
+		{
+			if (!hasFormat)
+			{
+				fprintf(stderr, "WAV data precedes its format\n");
+				return false;
+			}
+			// Truncated files and streamed headers overstate the size
+			if (chunkSize > fileSize - offset) chunkSize = fileSize - offset;
+
+			if (tag == 1 && bits == 16) s->format = SAMPLE_S16LE;
+			else if (tag == 1 && bits == 24) s->format = SAMPLE_S24LE;
+			else if (tag == 3 && bits == 32) s->format = SAMPLE_F32LE;
+			else
+			{
+				fprintf(stderr, "Unsupported WAV format %u with %u bits\n",
+				        tag, bits);
+				return false;
+			}
+			if (nChannels == 0 ||
+			    blockAlign < nChannels * sample_format_width(s->format))
+			{
+				fprintf(stderr, "Invalid WAV block alignment\n");
+				return false;
+			}
+			*dataOffset = offset;
+			s->stride = blockAlign;
+			s->nSamples = chunkSize / blockAlign;
+			return true;
+		}
+		// Chunks are padded to an even size
+		offset += chunkSize + (chunkSize & 1);
+	}
+	fprintf(stderr, "WAV file has no data\n");
+	return false;
+}
+bool SampleSource_open(struct SampleSource* const s,
+                       char const* const fileName, enum SampleFileType type,
+                       struct WorkerPool* const pool)
+{
+	assert(s);
+	memset(s, 0, sizeof(struct SampleSource));
+
+	int fd = open(fileName, O_RDONLY);
+	if (fd < 0)
+	{
+		fprintf(stderr, "Unable to open file\n");
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		fprintf(stderr, "File is empty\n");
+		close(fd);
+		return false;
+	}
+	s->mapSize = st.st_size;
+	s->map = mmap(NULL, s->mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (s->map == MAP_FAILED)
+	{
+		s->map = NULL;
+		fprintf(stderr, "Unable to map file\n");
+		return false;
+	}
+	madvise(s->map, s->mapSize, MADV_SEQUENTIAL);
+
+	if (type == SAMPLEFILE_AUTO)
+	{
+		if (s->mapSize >= 12 && memcmp(s->map, "RIFF", 4) == 0 &&
+		    memcmp((uint8_t*) s->map + 8, "WAVE", 4) == 0)
+			type = SAMPLEFILE_WAV;
+		else
+			type = SAMPLEFILE_TEXT;
+	}
+
+	switch (type)
+	{
+	case SAMPLEFILE_TEXT:
+		if (SampleSource_parse_text(s, pool)) return true;
+		SampleSource_close(s);
+		return false;
+	case SAMPLEFILE_WAV:
+	{
+		struct WavFile const file = { s->map, -1, s->mapSize };
+		size_t offset;
+		if (wav_parse(&file, s, &offset))
+		{
+			s->data = (uint8_t const*) s->map + offset;
+			return true;
+		}
+		SampleSource_close(s);
+		return false;
+	}
+	case SAMPLEFILE_S16LE:
+		s->format = SAMPLE_S16LE;
+		break;
+	case SAMPLEFILE_S24LE:
+		s->format = SAMPLE_S24LE;
+		break;
+	case SAMPLEFILE_F32LE:
+		s->format = SAMPLE_F32LE;
+		break;
+	default:
+		assert(false);
+	}
+	s->data = s->map;
+	s->stride = sample_format_width(s->format);
+	s->nSamples = s->mapSize / s->stride;
+	return true;
+}
+void SampleSource_close(struct SampleSource* const s)
+{
+	if (!s) return;
+	if (s->map) munmap(s->map, s->mapSize);
+	free(s->decoded);
+	memset(s, 0, sizeof(struct SampleSource));
+}
+void SampleSource_read(struct SampleSource const* const s,
+                       real* const out, size_t begin, size_t n)
+{
+	assert(begin + n <= s->nSamples);
+	uint8_t const* in = (uint8_t const*) s->data + begin * s->stride;
+	size_t const stride = s->stride;
+	switch (s->format)
+	{
+	case SAMPLE_REAL:
+		memcpy(out, (real const*) s->data + begin, sizeof(real) * n);
+		break;
+	case SAMPLE_S16LE:
+		for (size_t i = 0; i < n; ++i, in += stride)
+			out[i] = (int16_t) read_u16le(in) * (real) (1.0 / 32768);
+		break;
+	case SAMPLE_S24LE:
+		for (size_t i = 0; i < n; ++i, in += stride)
+		{
+			// Sign extend from bit 23
+			int32_t x = (int32_t) (read_u32le((uint8_t const[]) {
+			                         0, in[0], in[1], in[2] })) >> 8;
+			out[i] = x * (real) (1.0 / 8388608);
+		}
+		break;
+	case SAMPLE_F32LE:
+		for (size_t i = 0; i < n; ++i, in += stride)
+		{
+			uint32_t const bits = read_u32le(in);
+			float x;
+			memcpy(&x, &bits, sizeof(float));
+			out[i] = x;
+		}
+		break;
+	}
+}
+
+bool SampleStream_open(struct SampleStream* const s,
+                       char const* const fileName, enum SampleFileType type)
+{
+	assert(s);
+	memset(s, 0, sizeof(struct SampleStream));
+	s->fd = open(fileName, O_RDONLY);
+	if (s->fd < 0)
+	{
+		fprintf(stderr, "Unable to open file\n");
+		return false;
+	}
+	struct stat st;
+	if (fstat(s->fd, &st) != 0 || st.st_size == 0)
+	{
+		fprintf(stderr, "File is empty\n");
+		SampleStream_close(s);
+		return false;
+	}
+	size_t const fileSize = st.st_size;
+
+	if (type == SAMPLEFILE_AUTO)
+	{
+		uint8_t header[12];
+		ssize_t const headerSize = pread(s->fd, header, sizeof(header), 0);
+		if (headerSize < 0)
+		{
+			fprintf(stderr, "Unable to read file\n");
+			SampleStream_close(s);
+			return false;
+		}
+		if (headerSize == 12 && memcmp(header, "RIFF", 4) == 0 &&
+		    memcmp(header + 8, "WAVE", 4) == 0)
+			type = SAMPLEFILE_WAV;
+		else
+			type = SAMPLEFILE_TEXT;
+	}
+
+	struct SampleSource format;
+	memset(&format, 0, sizeof(struct SampleSource));
+	size_t dataOffset = 0;
+	switch (type)
+	{
+	case SAMPLEFILE_TEXT:
+		s->file = fdopen(s->fd, "r");
+		if (!s->file)
+		{
+			fprintf(stderr, "Unable to open file\n");
+			SampleStream_close(s);
+			return false;
+		}
+		s->fd = -1;
+		setvbuf(s->file, NULL, _IOFBF, 1 << 20);
+		s->line = 1;
+		ssize_t const length = getline(&s->lineBuffer, &s->lineBufferSize,
+		                               s->file);
+		if (length < 0 ||
+		    !parse_count(s->lineBuffer, s->lineBuffer + length, &s->nSamples))
+		{
+			fprintf(stderr, "Line 1: Invalid number of samples\n");
+			SampleStream_close(s);
+			return false;
+		}
+		s->format = SAMPLE_REAL;
+		return true;
+	case SAMPLEFILE_WAV:
+	{
+		struct WavFile const file = { NULL, s->fd, fileSize };
+		if (!wav_parse(&file, &format, &dataOffset))
+		{
+			SampleStream_close(s);
+			return false;
+		}
+		break;
+	}
+	case SAMPLEFILE_S16LE:
+		format.format = SAMPLE_S16LE;
+		break;
+	case SAMPLEFILE_S24LE:
+		format.format = SAMPLE_S24LE;
+		break;
+	case SAMPLEFILE_F32LE:
+		format.format = SAMPLE_F32LE;
+		break;
+	default:
+		assert(false);
+	}
+	if (type != SAMPLEFILE_WAV)
+	{
+		format.stride = sample_format_width(format.format);
+		format.nSamples = fileSize / format.stride;
+	}
+	s->format = format.format;
+	s->stride = format.stride;
+	s->nSamples = format.nSamples;
+	s->dataOffset = dataOffset;
+	return true;
+}
+void SampleStream_close(struct SampleStream* const s)
+{
+	if (!s) return;
+	if (s->file) fclose(s->file);
+	if (s->fd >= 0) close(s->fd);
+	free(s->buffer);
+	free(s->lineBuffer);
+	memset(s, 0, sizeof(struct SampleStream));
+	s->fd = -1;
+}
+/**
+ * @brief Reads the next line of the text format
+ */
+static bool SampleStream_next(struct SampleStream* const s, real* const out)
+{
+	++s->line;
+	ssize_t const length = getline(&s->lineBuffer, &s->lineBufferSize,
+	                               s->file);
+	if (length < 0)
+	{
+		fprintf(stderr, "Line %zu: Sample numbers do not match\n", s->line);
+		return false;
+	}
+	if (out && !parse_real(s->lineBuffer, s->lineBuffer + length, out))
+	{
+		fprintf(stderr, "Line %zu: Invalid sample\n", s->line);
+		return false;
+	}
+	return true;
+}
+bool SampleStream_read(struct SampleStream* const s,
+                       real* const out, size_t begin, size_t n)
+{
+	assert(begin + n <= s->nSamples);
+	if (s->file)
+	{
+		// The sample of index i is on line i + 2
+		assert(begin + 1 >= s->line);
+		while (s->line < begin + 1)
+		{
+			if (!SampleStream_next(s, NULL)) return false;
+		}
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (!SampleStream_next(s, &out[i])) return false;
+		}
+		return true;
+	}
+
+	size_t const size = n * s->stride;
+	if (size > s->bufferSize)
+	{
+		free(s->buffer);
+		s->buffer = malloc(size);
+		s->bufferSize = s->buffer ? size : 0;
+		if (!s->buffer)
+		{
+			fprintf(stderr, "Unable to allocate %zu bytes\n", size);
+			return false;
+		}
+	}
+	for (size_t done = 0; done < size;)
+	{
+		ssize_t const r = pread(s->fd, s->buffer + done, size - done,
+		                        s->dataOffset + begin * s->stride + done);
+		if (r <= 0)
+		{
+			fprintf(stderr, "Unable to read file\n");
+			return false;
+		}
+		done += r;
+	}
+	struct SampleSource chunk;
+	memset(&chunk, 0, sizeof(struct SampleSource));
+	chunk.format = s->format;
+	chunk.data = s->buffer;
+	chunk.stride = s->stride;
+	chunk.nSamples = n;
+	SampleSource_read(&chunk, out, 0, n);
+	return true;
+}
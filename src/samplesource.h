@@ -0,0 +1,139 @@
+#ifndef SPECTROGEN__SAMPLESOURCE_H_
+#define SPECTROGEN__SAMPLESOURCE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "spectrogen.h"
+#include "workerpool.h"
+
+/**
+ * Encoding of the samples in memory
+ */
+enum SampleFormat
+{
+	SAMPLE_REAL,
+	SAMPLE_S16LE,
+	SAMPLE_S24LE,
+	SAMPLE_F32LE,
+};
+/**
+ * Format of a sample file
+ */
+enum SampleFileType
+{
+	/**
+	 * WAV if the file starts with a RIFF WAVE header, text otherwise
+	 */
+	SAMPLEFILE_AUTO,
+	/**
+	 * First line: [NOS]: Number of sample
+	 * [NOS] lines follow. Each line containing a number
+	 */
+	SAMPLEFILE_TEXT,
+	/**
+	 * RIFF WAVE with 16 or 24 bit integer or 32 bit float PCM. Only the first
+	 * channel is read.
+	 */
+	SAMPLEFILE_WAV,
+	// Headerless mono PCM
+	SAMPLEFILE_S16LE,
+	SAMPLEFILE_S24LE,
+	SAMPLEFILE_F32LE,
+};
+
+/**
+ * A read only array of samples in any of the formats of enum SampleFormat.
+ * Binary files are memory mapped and converted to reals only when read.
+ */
+struct SampleSource
+{
+	enum SampleFormat format;
+	/**
+	 * Address of the first sample
+	 */
+	void const* data;
+	/**
+	 * Number of bytes between two adjacent samples
+	 */
+	size_t stride;
+	size_t nSamples;
+
+	// Owned by the source. Released by SampleSource_close
+	void* map;
+	size_t mapSize;
+	real* decoded;
+};
+
+/**
+ * @brief Wraps an array of reals. The array is not owned by the source.
+ */
+void SampleSource_init_array(struct SampleSource* const,
+                             real const* const samples, size_t nSamples);
+/**
+ * @brief Opens a sample file. Binary formats are memory mapped, text is
+ *  decoded.
+ * @param[in] pool Threads decoding text. If NULL, text is decoded on the
+ *  calling thread.
+ * @return false if the file cannot be read. The error, with the line number
+ *  for text, is printed to stderr.
+ */
+bool SampleSource_open(struct SampleSource* const,
+                       char const* const fileName, enum SampleFileType,
+                       struct WorkerPool* const pool);
+void SampleSource_close(struct SampleSource* const);
+/**
+ * @brief Converts the samples [begin, begin + n) to reals
+ * @param[out] out An array of size n
+ */
+void SampleSource_read(struct SampleSource const* const,
+                       real* const out, size_t begin, size_t n);
+
+/**
+ * A sample file read in order, one block at a time, for files larger than
+ * memory. Binary samples are read with pread and converted per block.
+ */
+struct SampleStream
+{
+	// Populated by SampleStream_open
+	enum SampleFormat format;
+	size_t stride;
+	size_t nSamples;
+
+	// Binary files
+	int fd;
+	size_t dataOffset;
+	uint8_t* buffer;
+	size_t bufferSize;
+
+	// Text files
+	FILE* file;
+	/**
+	 * Number of lines read
+	 */
+	size_t line;
+	/**
+	 * The last line read, grown by getline to fit
+	 */
+	char* lineBuffer;
+	size_t lineBufferSize;
+};
+
+/**
+ * @return false if the file cannot be read. The error is printed to stderr.
+ */
+bool SampleStream_open(struct SampleStream* const,
+                       char const* const fileName, enum SampleFileType);
+void SampleStream_close(struct SampleStream* const);
+/**
+ * @brief Converts the samples [begin, begin + n) to reals. Text files can only
+ *  be read forward: begin cannot precede the end of the previous read.
+ * @param[out] out An array of size n
+ * @return false on a read or parse error, which is printed to stderr
+ */
+bool SampleStream_read(struct SampleStream* const,
+                       real* const out, size_t begin, size_t n);
+
+#endif // !SPECTROGEN__SAMPLESOURCE_H_
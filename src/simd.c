@@ -0,0 +1,187 @@
+#include "simd.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * The tests compile the kernels for the single target SIMD_TARGET, or for the
+ * baseline with SIMD_BASELINE, to check each version of the clones
+ */
+#if defined(SIMD_TARGET)
+#define SIMD_DISPATCH __attribute__((target(SIMD_TARGET)))
+#elif defined(SIMD_BASELINE)
+#define SIMD_DISPATCH
+#elif defined(__x86_64__) && defined(__GNUC__) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+#define SIMD_DISPATCH \
+	__attribute__((target_clones("avx512f", "avx2", "default")))
+#endif
+#endif
+#ifndef SIMD_DISPATCH
+#define SIMD_DISPATCH
+#endif
+
+/*
+ * The kernels are written with vectors of SIMD_BYTES bytes, which the
+ * compiler splits into the registers of each target.
+ */
+#define SIMD_BYTES 64
+#define SIMD_LANES (SIMD_BYTES / (int) sizeof(real))
+
+/*
+ * Layout of the IEEE 754 representation of real
+ */
+#ifdef SPECTROGEN_SINGLE_PRECISION
+typedef uint32_t realbits;
+typedef int32_t realsigned;
+#define REAL_MANTISSA_BITS 23
+#define REAL_EXPONENT_MASK 0xFF
+#define REAL_EXPONENT_BIAS 127
+#define SIMD_REVERSE { 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 }
+#define SIMD_EVEN { 0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30 }
+#define SIMD_ODD { 1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31 }
+#else
+typedef uint64_t realbits;
+typedef int64_t realsigned;
+#define REAL_MANTISSA_BITS 52
+#define REAL_EXPONENT_MASK 0x7FF
+#define REAL_EXPONENT_BIAS 1023
+#define SIMD_REVERSE { 7, 6, 5, 4, 3, 2, 1, 0 }
+#define SIMD_EVEN { 0, 2, 4, 6, 8, 10, 12, 14 }
+#define SIMD_ODD { 1, 3, 5, 7, 9, 11, 13, 15 }
+#endif
+
+typedef real vreal __attribute__((vector_size(SIMD_BYTES)));
+typedef realbits vbits __attribute__((vector_size(SIMD_BYTES)));
+typedef realsigned vsigned __attribute__((vector_size(SIMD_BYTES)));
+
+SIMD_DISPATCH
+void simd_window(real* const out, real const* const in,
+                 real const* const window, size_t n)
+{
+	vsigned const reverse = SIMD_REVERSE;
+	size_t i = 0;
+	for (; i + SIMD_LANES <= n; i += SIMD_LANES)
+	{
+		vreal x, w;
+		memcpy(&x, in + i, sizeof(vreal));
+		memcpy(&w, window + n - i - SIMD_LANES, sizeof(vreal));
+		x *= __builtin_shuffle(w, reverse);
+		memcpy(out + i, &x, sizeof(vreal));
+	}
+	for (; i < n; ++i)
+		out[i] = in[i] * window[n - 1 - i];
+}
+SIMD_DISPATCH
+void simd_power(real* const out, comp const* const in, size_t n)
+{
+	vsigned const even = SIMD_EVEN;
+	vsigned const odd = SIMD_ODD;
+	real const* const parts = (real const*) in;
+	size_t i = 0;
+	for (; i + SIMD_LANES <= n; i += SIMD_LANES)
+	{
+		vreal a, b;
+		memcpy(&a, parts + 2 * i, sizeof(vreal));
+		memcpy(&b, parts + 2 * i + SIMD_LANES, sizeof(vreal));
+		vreal re = __builtin_shuffle(a, b, even);
+		vreal im = __builtin_shuffle(a, b, odd);
+		vreal p = re * re + im * im;
+		memcpy(out + i, &p, sizeof(vreal));
+	}
+	for (; i < n; ++i)
+	{
+		real re = parts[2 * i];
+		real im = parts[2 * i + 1];
+		out[i] = re * re + im * im;
+	}
+}
+SIMD_DISPATCH
+void simd_dot2(real* const outA, real* const outB, real const* const x,
+               real const* const a, real const* const b, size_t n)
+{
+	vreal sumA = { 0 };
+	vreal sumB = { 0 };
+	size_t i = 0;
+	for (; i + SIMD_LANES <= n; i += SIMD_LANES)
+	{
+		vreal vx, va, vb;
+		memcpy(&vx, x + i, sizeof(vreal));
+		memcpy(&va, a + i, sizeof(vreal));
+		memcpy(&vb, b + i, sizeof(vreal));
+		sumA += va * vx;
+		sumB += vb * vx;
+	}
+	real dotA = 0, dotB = 0;
+	for (int j = 0; j < SIMD_LANES; ++j)
+	{
+		dotA += sumA[j];
+		dotB += sumB[j];
+	}
+	for (; i < n; ++i)
+	{
+		dotA += a[i] * x[i];
+		dotB += b[i] * x[i];
+	}
+	*outA = dotA;
+	*outB = dotB;
+}
+/**
+ * @brief simd_log_amplitude on SIMD_LANES values
+ */
+__attribute__((always_inline))
+static inline void simd_log_amplitude_vector(real* const values)
+{
+	vreal x;
+	memcpy(&x, values, sizeof(vreal));
+	vbits const bits = (vbits) x;
+	vbits const exponent = (bits >> REAL_MANTISSA_BITS) & REAL_EXPONENT_MASK;
+	vbits const mantissa = bits & (((realbits) 1 << REAL_MANTISSA_BITS) - 1);
+	/*
+	 * x = m * 2^e with m in [sqrt(2)/2, sqrt(2)). Mantissas above sqrt(2) are
+	 * moved into the lower octave.
+	 */
+	realbits const sqrt2 = (realbits) (0.41421356237309504880 *
+	                                   ((realbits) 1 << REAL_MANTISSA_BITS));
+	vbits const upper = (vbits) (mantissa > sqrt2) & 1;
+	vreal const m = (vreal) (mantissa |
+	                         ((REAL_EXPONENT_BIAS - upper) << REAL_MANTISSA_BITS));
+	vreal const e = __builtin_convertvector((vsigned) (exponent + upper) -
+	                                        REAL_EXPONENT_BIAS, vreal);
+
+	/*
+	 * log(m) = 2 atanh(s) with s = (m - 1) / (m + 1) in [-0.172, 0.172]
+	 */
+	vreal const s = (m - 1) / (m + 1);
+	vreal const s2 = s * s;
+	vreal p = s2 * (real) (1.0 / 11) + (real) (1.0 / 9);
+	p = p * s2 + (real) (1.0 / 7);
+	p = p * s2 + (real) (1.0 / 5);
+	p = p * s2 + (real) (1.0 / 3);
+	p = p * s2 + 1;
+	// log(2 sqrt(x)) = log(x) / 2 + log(2)
+	vreal const y = s * p + e * (real) (M_LN2 / 2) + (real) M_LN2;
+
+	// Zero and subnormal powers have a zero exponent field
+	vbits const zero = (vbits) (exponent == 0);
+	vreal const negInf = x * 0 - INFINITY;
+	x = (vreal) (((vbits) y & ~zero) | ((vbits) negInf & zero));
+	memcpy(values, &x, sizeof(vreal));
+}
+SIMD_DISPATCH
+void simd_log_amplitude(real* const values, size_t n)
+{
+	size_t i = 0;
+	for (; i + SIMD_LANES <= n; i += SIMD_LANES)
+		simd_log_amplitude_vector(values + i);
+	if (i < n)
+	{
+		// The remaining values are padded to a whole vector
+		real padded[SIMD_LANES];
+		for (int j = 0; j < SIMD_LANES; ++j) padded[j] = 1;
+		memcpy(padded, values + i, sizeof(real) * (n - i));
+		simd_log_amplitude_vector(padded);
+		memcpy(values + i, padded, sizeof(real) * (n - i));
+	}
+}
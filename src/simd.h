@@ -0,0 +1,38 @@
+#ifndef SPECTROGEN__SIMD_H_
+#define SPECTROGEN__SIMD_H_
+
+#include <stddef.h>
+
+#include "spectrogen.h"
+
+/*
+ * Vectorised kernels of the spectrogram hot path. Where supported, each
+ * kernel is compiled for AVX-512, AVX2 and the baseline instruction set
+ * (SSE2 on x86-64) and the best version is chosen at load time.
+ */
+
+/**
+ * @brief Copies the samples and multiplies them by the reversed window:
+ *  out[i] = in[i] * window[n - 1 - i]. out and in may be the same array.
+ */
+void simd_window(real* const out, real const* const in,
+                 real const* const window, size_t n);
+/**
+ * @brief Squared magnitudes of a spectrum
+ */
+void simd_power(real* const out, comp const* const in, size_t n);
+/**
+ * @brief Two dot products sharing x: *outA = sum of a[i] * x[i] and
+ *  *outB = sum of b[i] * x[i]
+ */
+void simd_dot2(real* const outA, real* const outB, real const* const x,
+               real const* const a, real const* const b, size_t n);
+/**
+ * Uses a polynomial logarithm which differs from 0.5 * log(in[i]) + log(2) by
+ * less than 1e-6 in double precision and 1e-5 in single precision. Zero and
+ * subnormal powers map to -infinity.
+ * @brief Converts powers to log amplitudes in place: log(2 * sqrt(power))
+ */
+void simd_log_amplitude(real* const values, size_t n);
+
+#endif // !SPECTROGEN__SIMD_H_
@@ -0,0 +1,185 @@
+#include "sliding.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Number of samples between two recomputations of the spectrum from the
+ * history. Must exceed the window width, so the recomputation costs less
+ * than a component update per sample.
+ */
+#define SLIDING_REFRESH_PERIOD ((size_t) 1 << 20)
+
+bool SlidingDFT_init(struct SlidingDFT* const s, struct DSTFT const* const dstft,
+                     struct FrequencyLayout const* const layout)
+{
+	assert(s && dstft && dstft->window);
+	assert(layout && layout->binBegin);
+	assert(layout->windowRadius == dstft->windowRadius);
+	size_t const n = dstft->windowWidth;
+	real const* const window = dstft->window;
+
+	/*
+	 * The sample at index i of a frame is weighted by window[n - 1 - i], so the
+	 * first non-zero entry weights the newest sample.
+	 */
+	size_t first = 0;
+	while (first < n && window[first] == 0) ++first;
+	if (first == n) return false;
+	size_t length = 1;
+	while (first + length < n && window[first + length] != 0) ++length;
+	for (size_t j = first + length; j < n; ++j)
+	{
+		if (window[j] != 0) return false;
+	}
+	double const gain = window[first];
+	double const rho = length > 1 ?
+	                   pow(window[first + length - 1] / gain, 1.0 / (length - 1)) :
+	                   1.0;
+	double weight = gain;
+	for (size_t m = 0; m < length; ++m)
+	{
+		// The window is computed in the precision of real
+		if (fabs(window[first + m] - weight) > 1e-4 * fabs(weight)) return false;
+		weight *= rho;
+	}
+
+	assert(length < SLIDING_REFRESH_PERIOD);
+	memset(s, 0, sizeof(struct SlidingDFT));
+	s->windowWidth = n;
+	s->windowRadius = dstft->windowRadius;
+	s->newest = n - 1 - first;
+	s->length = length;
+	s->gain = gain;
+
+	// The components read by FrequencyLayout_eval
+	bool read[s->windowRadius + 1];
+	memset(read, 0, sizeof(read));
+	for (int row = 0; row < layout->height; ++row)
+	{
+		size_t const begin = layout->aggregation == AGGREGATE_POINT ?
+		                     layout->binEnd[row] - 1 : layout->binBegin[row];
+		for (size_t j = begin; j < layout->binEnd[row]; ++j)
+			read[j] = true;
+	}
+	s->bins = malloc(sizeof(size_t) * (s->windowRadius + 1));
+	for (size_t j = 0; j <= s->windowRadius; ++j)
+	{
+		if (read[j]) s->bins[s->nBins++] = j;
+	}
+
+	s->rotRe = malloc(sizeof(double) * s->nBins);
+	s->rotIm = malloc(sizeof(double) * s->nBins);
+	s->tailRe = malloc(sizeof(double) * s->nBins);
+	s->tailIm = malloc(sizeof(double) * s->nBins);
+	s->re = calloc(s->nBins, sizeof(double));
+	s->im = calloc(s->nBins, sizeof(double));
+	double const rhoLength = pow(rho, length);
+	for (size_t b = 0; b < s->nBins; ++b)
+	{
+		size_t const k = s->bins[b];
+		// Reduced exactly, so e^(i w R) is 1 for the rectangular window
+		double const angle = 2 * M_PI * (double) (k % n) / n;
+		double const angleLength = 2 * M_PI * (double) (k * length % n) / n;
+		s->rotRe[b] = rho * cos(angle);
+		s->rotIm[b] = rho * sin(angle);
+		s->tailRe[b] = gain * rhoLength * cos(angleLength);
+		s->tailIm[b] = gain * rhoLength * sin(angleLength);
+	}
+	s->history = calloc(length, sizeof(real));
+	s->power = calloc(s->windowRadius + 1, sizeof(real));
+	s->end = 0;
+	s->nextRefresh = SLIDING_REFRESH_PERIOD;
+	return true;
+}
+void SlidingDFT_destroy(struct SlidingDFT* const s)
+{
+	if (!s) return;
+	free(s->bins);
+	free(s->rotRe);
+	free(s->rotIm);
+	free(s->tailRe);
+	free(s->tailIm);
+	free(s->re);
+	free(s->im);
+	free(s->history);
+	free(s->power);
+}
+size_t SlidingDFT_frame_end(struct SlidingDFT const* const s, size_t centre)
+{
+	assert(s);
+	// The frame centred at centre begins at centre - windowRadius
+	return centre + s->newest + 1 > s->windowRadius ?
+	       centre + s->newest + 1 - s->windowRadius : 0;
+}
+
+/**
+ * @brief Recomputes the spectrum from the history
+ * @param newest Absolute index of the newest sample consumed. Cannot be less
+ *  than s->length - 1.
+ */
+static void sliding_refresh(struct SlidingDFT* const s, size_t newest)
+{
+	for (size_t b = 0; b < s->nBins; ++b)
+	{
+		double weightRe = s->gain, weightIm = 0;
+		double re = 0, im = 0;
+		for (size_t m = 0; m < s->length; ++m)
+		{
+			real const x = s->history[(newest - m) % s->length];
+			re += weightRe * x;
+			im += weightIm * x;
+			double const next = weightRe * s->rotRe[b] - weightIm * s->rotIm[b];
+			weightIm = weightRe * s->rotIm[b] + weightIm * s->rotRe[b];
+			weightRe = next;
+		}
+		s->re[b] = re;
+		s->im[b] = im;
+	}
+}
+void SlidingDFT_advance(struct SlidingDFT* const s,
+                        real const* const samples, size_t begin, size_t stop)
+{
+	assert(s && s->history);
+	if (begin > s->end)
+	{
+		memset(s->re, 0, sizeof(double) * s->nBins);
+		memset(s->im, 0, sizeof(double) * s->nBins);
+		memset(s->history, 0, sizeof(real) * s->length);
+		s->end = begin;
+		s->nextRefresh = begin + SLIDING_REFRESH_PERIOD;
+	}
+
+	size_t const nBins = s->nBins;
+	double* const re = s->re;
+	double* const im = s->im;
+	double const* const rotRe = s->rotRe;
+	double const* const rotIm = s->rotIm;
+	double const* const tailRe = s->tailRe;
+	double const* const tailIm = s->tailIm;
+	for (; s->end < stop; ++s->end)
+	{
+		real const x = samples[s->end - begin];
+		size_t const slot = s->end % s->length;
+		double const old = s->history[slot];
+		s->history[slot] = x;
+		double const in = s->gain * x;
+		for (size_t b = 0; b < nBins; ++b)
+		{
+			double const r = re[b];
+			double const i = im[b];
+			re[b] = rotRe[b] * r - rotIm[b] * i + in - tailRe[b] * old;
+			im[b] = rotRe[b] * i + rotIm[b] * r - tailIm[b] * old;
+		}
+		if (s->end + 1 == s->nextRefresh)
+		{
+			sliding_refresh(s, s->end);
+			s->nextRefresh += SLIDING_REFRESH_PERIOD;
+		}
+	}
+
+	for (size_t b = 0; b < nBins; ++b)
+		s->power[s->bins[b]] = re[b] * re[b] + im[b] * im[b];
+}
@@ -0,0 +1,103 @@
+#ifndef SPECTROGEN__SLIDING_H_
+#define SPECTROGEN__SLIDING_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "fourier.h"
+#include "layout.h"
+
+/**
+ * A sliding DFT. Holds the components read by a frequency layout of the
+ * spectrum of the frame ending at the newest sample, and updates them once per
+ * sample with
+ *
+ *   X(t) = g x(t) + r X(t - 1) - g r^R x(t - R),  r = rho e^(i w)
+ *
+ * so X(t) is the sum of g rho^m e^(i w m) x(t - m) over the last R samples.
+ * This is the spectrum of the windowed frame, up to a phase, whenever the
+ * window read backwards from its newest sample is the geometric sequence
+ * g rho^m: the rectangular window (rho = 1) and the exponential causal window.
+ *
+ * A sample costs O(nBins) instead of O(windowWidth log windowWidth) per
+ * column, which pays off when the hop between columns is small.
+ */
+struct SlidingDFT
+{
+	// Populated by SlidingDFT_init
+	size_t windowWidth;
+	size_t windowRadius;
+	/**
+	 * Index in the frame of the newest sample with a non-zero weight
+	 */
+	size_t newest;
+	/**
+	 * R, the number of samples with a non-zero weight
+	 */
+	size_t length;
+	/**
+	 * g, the weight of the newest sample
+	 */
+	double gain;
+	/**
+	 * The components tracked
+	 */
+	size_t nBins;
+	size_t* bins;
+	/*
+	 * Per tracked component: r, g r^R and X, split into real and imaginary
+	 * parts. The state is kept in double precision whatever real is, since
+	 * rounding errors accumulate over the samples.
+	 */
+	double* rotRe;
+	double* rotIm;
+	double* tailRe;
+	double* tailIm;
+	double* re;
+	double* im;
+	/**
+	 * The last R samples. The sample t is at history[t % R].
+	 */
+	real* history;
+	/**
+	 * Squared magnitudes of the spectrum, of size windowRadius + 1. Only the
+	 * tracked components are set, the others are 0.
+	 */
+	real* power;
+	/**
+	 * Absolute index of the sample after the newest consumed one
+	 */
+	size_t end;
+	/**
+	 * Absolute index of the next recomputation of X from history, which
+	 * discards the rounding errors accumulated until then
+	 */
+	size_t nextRefresh;
+};
+
+/**
+ * @brief Tracks the components of the spectra of dstft read by layout
+ * @return false if the window of dstft is not a truncated geometric sequence.
+ *  Nothing is allocated then.
+ */
+bool SlidingDFT_init(struct SlidingDFT* const, struct DSTFT const* const dstft,
+                     struct FrequencyLayout const* const layout);
+void SlidingDFT_destroy(struct SlidingDFT* const);
+/**
+ * @brief Absolute index of the sample after the newest one in the frame
+ *  centred at centre. Once SlidingDFT_advance has reached it, power holds the
+ *  spectrum of that frame.
+ */
+size_t SlidingDFT_frame_end(struct SlidingDFT const* const, size_t centre);
+/**
+ * @brief Consumes the samples up to the absolute index stop, and updates
+ *  power
+ * @param[in] samples samples[i] is the sample of absolute index begin + i. It
+ *  must hold the samples up to stop. If begin is past the newest sample
+ *  consumed, the samples in between are lost and the frames restart at begin
+ *  preceded by silence.
+ */
+void SlidingDFT_advance(struct SlidingDFT* const,
+                        real const* const samples, size_t begin, size_t stop);
+
+#endif // !SPECTROGEN__SLIDING_H_
@@ -3,12 +3,24 @@
 
 #include <complex.h>
 
+/*
+ * Define SPECTROGEN_SINGLE_PRECISION to run the whole pipeline in single
+ * precision. It must be defined consistently for every translation unit.
+ */
+#ifdef SPECTROGEN_SINGLE_PRECISION
+typedef float real;
+typedef float complex comp;
+#else
 typedef double real;
 typedef double complex comp;
+#endif
 
 #ifndef M_PI
 #define M_PI 3.141592653589793238462643383279502884197169399375105820974
 #endif
+#ifndef M_LN2
+#define M_LN2 0.693147180559945309417232121458176568075500134360255254120
+#endif
 #ifndef M_E
 #define M_E 2.718281828459045235360287471352662497757247093699959574966
 #endif
@@ -3,64 +3,609 @@
 #include <string.h>
 #include <assert.h>
 #include <math.h>
+#include <stdlib.h>
 
-void spectrogram_populate(uint8_t* const image, int width, int height,
-                          real const* const samples, size_t nSamples,
-                          bool crop,
-                          struct ColourGradient const* const grad,
-                          struct DSTFT* const dstft)
+#include <SDL2/SDL.h>
+
+#include "constantq.h"
+#include "simd.h"
+
+/**
+ * @brief Copies the window centred at sample i into frame, padding with
+ *  zeros where the window exceeds [0, source->nSamples), and applies the
+ *  window function.
+ * @param[out] frame An array of size dstft->windowWidth
+ */
+static void spectrogram_frame(real* const frame,
+                              struct DSTFT const* const dstft,
+                              struct SampleSource const* const source,
+                              size_t i)
+{
+	size_t const width = dstft->windowWidth;
+	size_t const radius = dstft->windowRadius;
+	// frame[k] holds sample i - radius + k for k in [begin, end)
+	size_t const begin = i < radius ? radius - i : 0;
+	size_t const end = i + width - radius > source->nSamples ?
+	                   source->nSamples + radius - i : width;
+	memset(frame, 0, sizeof(real) * begin);
+	if (source->format == SAMPLE_REAL)
+	{
+		simd_window(frame + begin,
+		            (real const*) source->data + (i + begin - radius),
+		            dstft->window + width - end, end - begin);
+	}
+	else
+	{
+		// Converted only as the window needs them
+		SampleSource_read(source, frame + begin, i + begin - radius,
+		                  end - begin);
+		simd_window(frame + begin, frame + begin,
+		            dstft->window + width - end, end - begin);
+	}
+	memset(frame + end, 0, sizeof(real) * (width - end));
+}
+/**
+ * @brief Transforms the frames centred at the samples centres[k]. The k-th
+ *  spectrum is stored at dstft->spectrum + k * (dstft->windowRadius + 1).
+ * @param[in] nFrames Number of frames. Cannot exceed dstft->batchSize
+ */
+static void spectrogram_transform(struct DSTFT* const dstft,
+                                  struct SampleSource const* const source,
+                                  size_t const* const centres, size_t nFrames)
 {
-	assert(nSamples >= dstft->windowWidth);
+	assert(nFrames <= dstft->batchSize);
+	// The plans may be shared between workspaces, see DSTFT_init_copy
+	if (nFrames > 1 && nFrames == dstft->batchSize)
+	{
+		for (size_t k = 0; k < nFrames; ++k)
+		{
+			spectrogram_frame(dstft->buffer + k * dstft->windowWidth, dstft,
+			                  source, centres[k]);
+		}
+		FFTW(execute_dft_r2c)(dstft->planBatch, dstft->buffer, dstft->spectrum);
+		return;
+	}
 
-	memset(dstft->buffer, 0, sizeof(real) * dstft->windowWidth);
+	/*
+	 * A partial batch is transformed a frame at a time instead of padding it
+	 * to a whole batch. Each frame goes through the start of the arrays, where
+	 * the single frame plan is aligned, and the last frame goes first so that
+	 * the spectrum of frame 0 is left in place.
+	 */
+	size_t const stride = dstft->windowRadius + 1;
+	for (size_t k = nFrames; k-- > 0;)
+	{
+		spectrogram_frame(dstft->buffer, dstft, source, centres[k]);
+		FFTW(execute_dft_r2c)(dstft->plan, dstft->buffer, dstft->spectrum);
+		if (k)
+		{
+			memcpy(dstft->spectrum + k * stride, dstft->spectrum,
+			       sizeof(comp) * stride);
+		}
+	}
+}
+/**
+ * @brief Writes one column of log amplitudes into image
+ * @param[in] col Index of the column
+ * @param pair Scratch space of size 2 * ((height + 1) / 2) holding the chroma
+ *  of the previous column of a YUV420P image
+ * @param pending Index of the column held in pair, or -1
+ */
+static void spectrogram_shade(struct SpectrogramImage const* const image,
+                              int col, real const* const amplitudes, int height,
+                              struct ColourGradient const* const grad,
+                              uint8_t* const pair, int* const pending)
+{
+	if (image->format == SPECTROGRAM_RGB24)
+	{
+		uint8_t* pixel = image->planes[0] + col * 3;
+		for (int row = 0; row < height; ++row)
+		{
+			ColourGradient_eval(grad, amplitudes[row], pixel);
+			pixel += image->pitches[0];
+		}
+		return;
+	}
 
-	size_t n = crop ? nSamples - dstft->windowWidth : nSamples;
-	size_t offset = crop ? dstft->windowRadius : 0;
-	for (int col = 0; col < width; ++col)
+	// Chroma of the column, halved vertically
+	int const heightUV = (height + 1) / 2;
+	uint8_t chroma[2 * heightUV];
+	uint8_t* pixel = image->planes[0] + col;
+	for (int row = 0; row < height; row += 2)
 	{
-		size_t i = col * n / (real) width + offset;
-		if (crop || (i >= dstft->windowRadius &&
-		             i + dstft->windowRadius <= nSamples))
+		uint8_t yuv0[3], yuv1[3];
+		ColourGradient_eval_yuv(grad, amplitudes[row], yuv0);
+		*pixel = yuv0[0];
+		pixel += image->pitches[0];
+		if (row + 1 < height)
 		{
-			memcpy(dstft->buffer, samples + i - dstft->windowRadius,
-			       sizeof(real) * dstft->windowWidth);
+			ColourGradient_eval_yuv(grad, amplitudes[row + 1], yuv1);
+			*pixel = yuv1[0];
+			pixel += image->pitches[0];
 		}
-		else if (i < dstft->windowRadius)
+		else memcpy(yuv1, yuv0, 3);
+		chroma[row / 2] = (yuv0[1] + yuv1[1] + 1) / 2;
+		chroma[heightUV + row / 2] = (yuv0[2] + yuv1[2] + 1) / 2;
+	}
+
+	size_t offset = col;
+	if (image->format == SPECTROGRAM_YUV420P)
+	{
+		/*
+		 * Each chroma sample covers a pair of columns. The even column is held
+		 * until the odd one arrives.
+		 */
+		if (col % 2 == 0)
 		{
-			memcpy(dstft->buffer + dstft->windowRadius - i, samples,
-			       sizeof(real) * (dstft->windowRadius + i));
+			memcpy(pair, chroma, 2 * heightUV);
+			*pending = col;
 		}
-		else if (i + dstft->windowRadius > nSamples)
+		else if (*pending == col - 1)
 		{
-			memset(dstft->buffer + dstft->windowRadius + nSamples - i, 0,
-			       sizeof(real) * (dstft->windowRadius + i - nSamples));
-			memcpy(dstft->buffer, samples + i - dstft->windowRadius,
-			       sizeof(real) * (dstft->windowRadius + nSamples - i));
+			for (int i = 0; i < 2 * heightUV; ++i)
+				chroma[i] = (chroma[i] + pair[i] + 1) / 2;
+			*pending = -1;
 		}
-		convolve(dstft->buffer, dstft->window, dstft->windowWidth);
-		fftw_execute(dstft->plan);
+		offset = col / 2;
+	}
+	for (int row = 0; row < heightUV; ++row)
+	{
+		image->planes[1][offset + row * image->pitches[1]] = chroma[row];
+		image->planes[2][offset + row * image->pitches[2]] = chroma[heightUV + row];
+	}
+}
 
-		for (int row = 0; row < height; ++row)
+/**
+ * A set of columns to be transformed and shaded, or transformed only
+ */
+struct SpectrogramJob
+{
+	struct SampleSource const* source;
+	/**
+	 * centres[k] is the index of the sample at the centre of the k-th column,
+	 * which is drawn at the column columns[k] of image.
+	 */
+	size_t const* centres;
+	int const* columns;
+	size_t nColumns;
+	struct SpectrogramImage const* image;
+	struct FrequencyLayout const* layout;
+	struct ColourGradient const* grad;
+	/**
+	 * If not NULL, the power spectrum of the k-th column is stored at
+	 * powers + k * (windowRadius + 1) instead of being shaded
+	 */
+	real* powers;
+	/**
+	 * If not NULL, the log amplitudes of the k-th column are stored at
+	 * amplitudes + k * layout->height instead of being shaded
+	 */
+	real* amplitudes;
+	struct DSTFT* dstft;
+#ifdef SPECTROGEN_PROFILE
+	/**
+	 * If not NULL, each share records its time spent transforming and shading
+	 */
+	struct Profile* profile;
+#endif
+};
+static int spectrogram_job_run(struct SpectrogramJob* const job)
+{
+	struct DSTFT* const dstft = job->dstft;
+	int const height = job->layout ? job->layout->height : 1;
+	real amplitudes[height];
+	uint8_t pair[2 * ((height + 1) / 2)];
+	int pending = -1;
+	PROFILE_COUNTER(ticksTransform);
+	PROFILE_COUNTER(ticksShade);
+	for (size_t k = 0; k < job->nColumns; k += dstft->batchSize)
+	{
+		size_t nFrames = job->nColumns - k;
+		if (nFrames > dstft->batchSize) nFrames = dstft->batchSize;
+
+		PROFILE_TIME(timeTransform);
+		spectrogram_transform(dstft, job->source, job->centres + k, nFrames);
+		PROFILE_TIME(timeShade);
+		for (size_t l = 0; l < nFrames; ++l)
 		{
-			/*
-			 * (height - row) flips the spectrogram upside down
-			 * a nonlinear map casts [0, height] to [0, windowRadius]. The +1 avoids
-			 * the constant term and allows the highest component of frequency to be
-			 * shown.
-			 */
-			real t = (height - row) / (real) height;
-#ifdef SPECTROGRAM_LOGARITHMIC
-			size_t j = (pow(2, t) - 1) * dstft->windowRadius + 1;
-#else
-			size_t j = t * dstft->windowRadius + 1;
+			comp const* const spectrum =
+			  dstft->spectrum + l * (dstft->windowRadius + 1);
+			if (job->powers)
+			{
+				simd_power(job->powers + (k + l) * (dstft->windowRadius + 1),
+				           spectrum, dstft->windowRadius + 1);
+				continue;
+			}
+			real* const column = job->amplitudes ?
+			                     job->amplitudes + (k + l) * height : amplitudes;
+			if (job->layout->constantQ)
+			{
+				ConstantQ_eval(job->layout->constantQ, column, spectrum);
+			}
+			else
+			{
+				simd_power(dstft->power, spectrum, dstft->windowRadius + 1);
+				FrequencyLayout_eval(job->layout, column, dstft->power);
+			}
+			if (job->amplitudes) continue;
+			spectrogram_shade(job->image, job->columns[k + l], column, height,
+			                  job->grad, pair, &pending);
+		}
+		PROFILE_TIME(timeEnd);
+		PROFILE_ADD(ticksTransform, timeTransform, timeShade);
+		PROFILE_ADD(ticksShade, timeShade, timeEnd);
+	}
+	PROFILE_RECORD_TICKS(job->profile, PROFILE_FFT, ticksTransform);
+	PROFILE_RECORD_TICKS(job->profile, PROFILE_SHADE, ticksShade);
+	return 0;
+}
+/**
+ * @brief Splits the columns of job between nThreads workspaces, whose shares
+ *  run on the workers of dstfts[0].pool and the calling thread
+ */
+static void spectrogram_job_exec(struct SpectrogramJob const* const job,
+                                 struct DSTFT* const dstfts, size_t nThreads)
+{
+	assert(nThreads >= 1);
+	// Each share is a whole number of batches
+	size_t const batchSize = dstfts[0].batchSize;
+	size_t nBatches = (job->nColumns + batchSize - 1) / batchSize;
+	if (nThreads > nBatches) nThreads = nBatches;
+	if (nThreads <= 1)
+	{
+		struct SpectrogramJob share = *job;
+		share.dstft = &dstfts[0];
+		spectrogram_job_run(&share);
+		return;
+	}
+
+	struct SpectrogramJob shares[nThreads];
+	size_t begin = 0;
+	for (size_t t = 0; t < nThreads; ++t)
+	{
+		size_t end = (nBatches * (t + 1) / nThreads) * batchSize;
+		// Pairs of columns sharing chroma stay in one share
+		if (job->image && job->image->format == SPECTROGRAM_YUV420P)
+			end += end % 2;
+		if (end > job->nColumns) end = job->nColumns;
+		shares[t] = *job;
+		shares[t].centres = job->centres + begin;
+		if (job->columns) shares[t].columns = job->columns + begin;
+		if (job->powers)
+			shares[t].powers = job->powers + begin * (dstfts[0].windowRadius + 1);
+		if (job->amplitudes)
+			shares[t].amplitudes = job->amplitudes + begin * job->layout->height;
+		shares[t].nColumns = end - begin;
+		shares[t].dstft = &dstfts[t];
+		begin = end;
+	}
+	WorkerPool_exec(dstfts[0].pool, (int (*)(void*)) spectrogram_job_run,
+	                shares, sizeof(struct SpectrogramJob), nThreads);
+}
+
+/**
+ * @brief Shades the columns of job from a sliding DFT instead of transforms.
+ *  The centres must increase.
+ * @param[in] samples The samples of job->source
+ * @param begin Absolute index of samples[0]
+ */
+static void spectrogram_sliding_run(struct SpectrogramJob const* const job,
+                                    struct SlidingDFT* const sliding,
+                                    real const* const samples, size_t begin)
+{
+	int const height = job->layout->height;
+	real amplitudes[height];
+	uint8_t pair[2 * ((height + 1) / 2)];
+	int pending = -1;
+	PROFILE_COUNTER(ticksTransform);
+	PROFILE_COUNTER(ticksShade);
+	for (size_t k = 0; k < job->nColumns; ++k)
+	{
+		PROFILE_TIME(timeTransform);
+		SlidingDFT_advance(sliding, samples, begin,
+		                   SlidingDFT_frame_end(sliding, begin + job->centres[k]));
+		PROFILE_TIME(timeShade);
+		FrequencyLayout_eval(job->layout, amplitudes, sliding->power);
+		spectrogram_shade(job->image, job->columns[k], amplitudes, height,
+		                  job->grad, pair, &pending);
+		PROFILE_TIME(timeEnd);
+		PROFILE_ADD(ticksTransform, timeTransform, timeShade);
+		PROFILE_ADD(ticksShade, timeShade, timeEnd);
+	}
+	PROFILE_RECORD_TICKS(job->profile, PROFILE_FFT, ticksTransform);
+	PROFILE_RECORD_TICKS(job->profile, PROFILE_SHADE, ticksShade);
+}
+
+void spectrogram_populate(uint8_t* const image, int width,
+                          real const* const samples, size_t nSamples,
+                          bool crop,
+                          struct FrequencyLayout const* const layout,
+                          struct ColourGradient const* const grad,
+                          struct DSTFT* const dstft)
+{
+	spectrogram_populate_parallel(image, width, samples, nSamples,
+	                              crop, layout, grad, dstft, 1);
+}
+void spectrogram_populate_parallel(uint8_t* const image, int width,
+                                   real const* const samples, size_t nSamples,
+                                   bool crop,
+                                   struct FrequencyLayout const* const layout,
+                                   struct ColourGradient const* const grad,
+                                   struct DSTFT* const dstfts, size_t nThreads)
+{
+	struct SpectrogramImage rgb;
+	memset(&rgb, 0, sizeof(struct SpectrogramImage));
+	rgb.format = SPECTROGRAM_RGB24;
+	rgb.planes[0] = image;
+	rgb.pitches[0] = width * 3;
+	struct SampleSource source;
+	SampleSource_init_array(&source, samples, nSamples);
+	spectrogram_populate_image(&rgb, width, &source, crop,
+	                           layout, grad, dstfts, nThreads);
+}
+void spectrogram_populate_image(struct SpectrogramImage const* const image,
+                                int width,
+                                struct SampleSource const* const source,
+                                bool crop,
+                                struct FrequencyLayout const* const layout,
+                                struct ColourGradient const* const grad,
+                                struct DSTFT* const dstfts, size_t nThreads)
+{
+	size_t const nSamples = source->nSamples;
+	assert(nSamples >= dstfts[0].windowWidth);
+
+	size_t n = crop ? nSamples - dstfts[0].windowWidth : nSamples;
+	size_t offset = crop ? dstfts[0].windowRadius : 0;
+	size_t* const centres = malloc(sizeof(size_t) * width);
+	int* const columns = malloc(sizeof(int) * width);
+	for (int col = 0; col < width; ++col)
+	{
+		centres[col] = spectrogram_centre(col, width, n) + offset;
+		columns[col] = col;
+	}
+	spectrogram_populate_columns(image, source, centres, columns, width,
+	                             layout, grad, dstfts, nThreads);
+
+	free(centres);
+	free(columns);
+}
+void spectrogram_populate_columns(struct SpectrogramImage const* const image,
+                                  struct SampleSource const* const source,
+                                  size_t const* const centres,
+                                  int const* const columns, size_t nColumns,
+                                  struct FrequencyLayout const* const layout,
+                                  struct ColourGradient const* const grad,
+                                  struct DSTFT* const dstfts, size_t nThreads)
+{
+	assert(layout->windowRadius == dstfts[0].windowRadius);
+
+	struct SpectrogramJob job;
+	job.source = source;
+	job.centres = centres;
+	job.columns = columns;
+	job.nColumns = nColumns;
+	job.image = image;
+	job.layout = layout;
+	job.grad = grad;
+	job.powers = NULL;
+	job.amplitudes = NULL;
+#ifdef SPECTROGEN_PROFILE
+	job.profile = NULL;
+#endif
+	spectrogram_job_exec(&job, dstfts, nThreads);
+}
+void spectrogram_power_columns(real* const powers,
+                               struct SampleSource const* const source,
+                               size_t const* const centres, size_t nColumns,
+                               struct DSTFT* const dstfts, size_t nThreads)
+{
+	struct SpectrogramJob job;
+	memset(&job, 0, sizeof(struct SpectrogramJob));
+	job.source = source;
+	job.centres = centres;
+	job.nColumns = nColumns;
+	job.powers = powers;
+	spectrogram_job_exec(&job, dstfts, nThreads);
+}
+void spectrogram_amplitude_columns(real* const amplitudes,
+                                   struct SampleSource const* const source,
+                                   size_t const* const centres,
+                                   size_t nColumns,
+                                   struct FrequencyLayout const* const layout,
+                                   struct DSTFT* const dstfts, size_t nThreads)
+{
+	assert(layout->windowRadius == dstfts[0].windowRadius);
+
+	struct SpectrogramJob job;
+	memset(&job, 0, sizeof(struct SpectrogramJob));
+	job.source = source;
+	job.centres = centres;
+	job.nColumns = nColumns;
+	job.layout = layout;
+	job.amplitudes = amplitudes;
+	spectrogram_job_exec(&job, dstfts, nThreads);
+}
+void spectrogram_shade_columns(struct SpectrogramImage const* const image,
+                               real const* const amplitudes,
+                               int height, int width,
+                               struct ColourGradient const* const grad)
+{
+	uint8_t pair[2 * ((height + 1) / 2)];
+	int pending = -1;
+	for (int col = 0; col < width; ++col)
+	{
+		spectrogram_shade(image, col, amplitudes + col * height, height,
+		                  grad, pair, &pending);
+	}
+}
+size_t spectrogram_centre(int col, int width, size_t n)
+{
+	return col * n / (real) width;
+}
+
+void SpectrogramScroll_init(struct SpectrogramScroll* const s)
+{
+	assert(s);
+	assert(s->width > 0 && s->height > 0);
+	assert(s->hop);
+	memset(&s->ring, 0, sizeof(struct SpectrogramImage));
+	if (s->format == SPECTROGRAM_RGB24)
+	{
+		s->ring.format = SPECTROGRAM_RGB24;
+		s->ring.pitches[0] = s->width * 3;
+		s->ring.planes[0] = calloc(3 * s->width * s->height, sizeof(uint8_t));
+	}
+	else
+	{
+		/*
+		 * The chroma of every column is kept, so pairs of columns can be
+		 * combined wherever the ring is unwrapped.
+		 */
+		size_t const heightUV = (s->height + 1) / 2;
+		s->ring.format = SPECTROGRAM_YUV440P;
+		s->ring.pitches[0] = s->ring.pitches[1] = s->ring.pitches[2] = s->width;
+		s->ring.planes[0] = malloc(s->width * s->height);
+		s->ring.planes[1] = malloc(s->width * heightUV);
+		s->ring.planes[2] = malloc(s->width * heightUV);
+		// Black
+		memset(s->ring.planes[0], 16, s->width * s->height);
+		memset(s->ring.planes[1], 128, s->width * heightUV);
+		memset(s->ring.planes[2], 128, s->width * heightUV);
+	}
+	s->head = 0;
+	s->nextCentre = 0;
+	s->sliding = NULL;
+#ifdef SPECTROGEN_PROFILE
+	s->profile = NULL;
+#endif
+}
+void SpectrogramScroll_destroy(struct SpectrogramScroll* const s)
+{
+	if (!s) return;
+	for (int i = 0; i < 3; ++i)
+		free(s->ring.planes[i]);
+}
+int SpectrogramScroll_update(struct SpectrogramScroll* const s,
+                             real const* const samples, size_t nSamples,
+                             size_t end,
+                             struct FrequencyLayout const* const layout,
+                             struct ColourGradient const* const grad,
+                             struct DSTFT* const dstfts, size_t nThreads)
+{
+	assert(s && s->ring.planes[0]);
+	assert(layout->height == s->height);
+	assert(layout->windowRadius == dstfts[0].windowRadius);
+	assert(nSamples >= dstfts[0].windowWidth && end >= nSamples);
+
+	size_t const begin = end - nSamples;
+	size_t const radius = dstfts[0].windowRadius;
+	// The column centred at c needs the samples [c - radius, c + radius)
+	size_t const first = (begin + radius + s->hop - 1) / s->hop * s->hop;
+	size_t const last = (end - dstfts[0].windowWidth + radius) / s->hop * s->hop;
+	if (s->nextCentre > last) return 0;
+
+	size_t nColumns = (last - s->nextCentre) / s->hop + 1;
+	size_t nSkipped = 0;
+	if (s->nextCentre < first)
+	{
+		// The columns between nextCentre and first have left the history
+		nSkipped = (first - s->nextCentre) / s->hop;
+		if (nSkipped > nColumns) nSkipped = nColumns;
+		nColumns -= nSkipped;
+	}
+	if (nColumns > (size_t) s->width)
+	{
+		nSkipped += nColumns - s->width;
+		nColumns = s->width;
+	}
+	if (nSkipped)
+	{
+		/*
+		 * Keep the columns pinned to their hops by blanking the skipped ones
+		 */
+		real blank[s->height];
+		for (int row = 0; row < s->height; ++row)
+			blank[row] = -INFINITY;
+		size_t nBlank = nSkipped < (size_t) s->width ? nSkipped : (size_t) s->width;
+		for (size_t k = 0; k < nBlank; ++k)
+		{
+			spectrogram_shade(&s->ring, (s->head + k) % s->width, blank,
+			                  s->height, grad, NULL, NULL);
+		}
+		s->head = (s->head + nSkipped) % s->width;
+		s->nextCentre += nSkipped * s->hop;
+	}
+
+	if (nColumns == 0) return 0;
+
+	size_t* const centres = malloc(sizeof(size_t) * nColumns);
+	int* const columns = malloc(sizeof(int) * nColumns);
+	for (size_t k = 0; k < nColumns; ++k)
+	{
+		centres[k] = s->nextCentre - begin;
+		columns[k] = s->head;
+		if (++s->head == s->width) s->head = 0;
+		s->nextCentre += s->hop;
+	}
+
+	struct SampleSource source;
+	SampleSource_init_array(&source, samples, nSamples);
+	struct SpectrogramJob job;
+	job.source = &source;
+	job.centres = centres;
+	job.columns = columns;
+	job.nColumns = nColumns;
+	job.image = &s->ring;
+	job.layout = layout;
+	job.grad = grad;
+	job.powers = NULL;
+	job.amplitudes = NULL;
+#ifdef SPECTROGEN_PROFILE
+	job.profile = s->profile;
 #endif
-			/*
-			 * Must multiply amplitude by 2 so maximum amplitude is 1
-			 */
-			double amplitude = log(cabs(dstft->spectrum[j]) * 2);
+	if (s->sliding)
+		spectrogram_sliding_run(&job, s->sliding, samples, begin);
+	else
+		spectrogram_job_exec(&job, dstfts, nThreads);
 
-			int pixel = (col + row * width) * 3;
-			ColourGradient_eval(grad, amplitude, image + pixel);
+	free(centres);
+	free(columns);
+	return (int) nColumns;
+}
+void SpectrogramScroll_render(struct SpectrogramScroll const* const s,
+                              struct SpectrogramImage const* const image)
+{
+	assert(s && image);
+	assert(image->format == s->format);
+	// Slot head holds the oldest column
+	size_t const bpp = s->format == SPECTROGRAM_RGB24 ? 3 : 1;
+	size_t const pitch = s->width * bpp;
+	size_t const nOld = (s->width - s->head) * bpp;
+	for (int row = 0; row < s->height; ++row)
+	{
+		uint8_t const* const in = s->ring.planes[0] + row * s->ring.pitches[0];
+		uint8_t* const out = image->planes[0] + row * image->pitches[0];
+		memcpy(out, in + s->head * bpp, nOld);
+		memcpy(out + nOld, in, pitch - nOld);
+	}
+	if (s->format == SPECTROGRAM_RGB24) return;
+
+	// Combine the chroma of each pair of columns
+	int const heightUV = (s->height + 1) / 2;
+	for (int plane = 1; plane < 3; ++plane)
+	{
+		for (int row = 0; row < heightUV; ++row)
+		{
+			uint8_t const* const in = s->ring.planes[plane] +
+			                          row * s->ring.pitches[plane];
+			uint8_t* const out = image->planes[plane] + row * image->pitches[plane];
+			int slot = s->head;
+			for (int col = 0; col < s->width / 2; ++col)
+			{
+				int next = slot + 1 == s->width ? 0 : slot + 1;
+				out[col] = (in[slot] + in[next] + 1) / 2;
+				slot = next + 1 == s->width ? 0 : next + 1;
+			}
 		}
 	}
 }
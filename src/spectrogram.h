@@ -6,27 +6,213 @@
 
 #include "fourier.h"
 #include "gradient.h"
+#include "layout.h"
+#include "profile.h"
+#include "samplesource.h"
+#include "sliding.h"
 
+/**
+ * Define SPECTROGRAM_LOGARITHMIC to draw logarithmic graph by default
+ */
 #define SPECTROGRAM_LOGARITHMIC
 
+enum SpectrogramFormat
+{
+	/**
+	 * Packed RGB888 in planes[0]
+	 */
+	SPECTROGRAM_RGB24,
+	/**
+	 * Planar BT.601 YUV with the chroma halved in both directions. The width
+	 * must be even.
+	 */
+	SPECTROGRAM_YUV420P,
+	/**
+	 * Planar BT.601 YUV with the chroma halved vertically
+	 */
+	SPECTROGRAM_YUV440P,
+};
+/**
+ * An output image. Only planes[0] is used in SPECTROGRAM_RGB24.
+ */
+struct SpectrogramImage
+{
+	enum SpectrogramFormat format;
+	uint8_t* planes[3];
+	/**
+	 * Number of bytes between two adjacent rows of each plane
+	 */
+	size_t pitches[3];
+};
+
 /**
- * Define SPECTROGRAM_LOGARITHMIC to draw logarithmic graph
  * @brief Converts the samples to a spectrogram
- * @param[out] image An array of size 3 * width * height in the RGB888, width
- *	major format for storing the pixels.
+ * @param[out] image An array of size 3 * width * layout->height in the RGB888,
+ *	width major format for storing the pixels.
  * @param[in] width Width of the image
- * @param[in] height Height of the image
  * @param[in] samples An array of reals representing the samples
  * @param[in] nSamples The number of samples.
  * @param[in] crop If set to true, the first and last windowRadius samples will
  *	not be shown. This is useful if the samples are being streamed.
+ * @param[in] layout Maps the rows onto the spectrum. Determines the height of
+ *  the image.
  * @param[in] grad A colour gradient for shading the spectrogram
  * @param dstft A struct DSTFT for the window and the buffer
  */
-void spectrogram_populate(uint8_t* const image, int width, int height,
+void spectrogram_populate(uint8_t* const image, int width,
                           real const* const samples, size_t nSamples,
                           bool crop,
+                          struct FrequencyLayout const* const layout,
                           struct ColourGradient const* const grad,
                           struct DSTFT* const dstft);
+/**
+ * @brief Parallel version of spectrogram_populate with identical output. The
+ *  columns are split between nThreads threads.
+ * @param dstfts An array of nThreads workspaces, one per thread, with the
+ *  same window. See DSTFT_init_copy. The shares run on dstfts[0].pool.
+ */
+void spectrogram_populate_parallel(uint8_t* const image, int width,
+                                   real const* const samples, size_t nSamples,
+                                   bool crop,
+                                   struct FrequencyLayout const* const layout,
+                                   struct ColourGradient const* const grad,
+                                   struct DSTFT* const dstfts, size_t nThreads);
+/**
+ * @brief Version of spectrogram_populate_parallel that writes the pixels in
+ *  the format of image, skipping the conversion from RGB888.
+ * @param[out] image An image of size width * layout->height
+ * @param[in] source The samples, converted to reals as each window is read
+ */
+void spectrogram_populate_image(struct SpectrogramImage const* const image,
+                                int width,
+                                struct SampleSource const* const source,
+                                bool crop,
+                                struct FrequencyLayout const* const layout,
+                                struct ColourGradient const* const grad,
+                                struct DSTFT* const dstfts, size_t nThreads);
+
+/**
+ * @brief Populates the column columns[k] of image from the window centred at
+ *  the sample centres[k] of source, for k in [0, nColumns). The windows are
+ *  padded with zeros outside [0, source->nSamples).
+ */
+void spectrogram_populate_columns(struct SpectrogramImage const* const image,
+                                  struct SampleSource const* const source,
+                                  size_t const* const centres,
+                                  int const* const columns, size_t nColumns,
+                                  struct FrequencyLayout const* const layout,
+                                  struct ColourGradient const* const grad,
+                                  struct DSTFT* const dstfts, size_t nThreads);
+/**
+ * @brief Computes the power spectra of the windows centred at the samples
+ *  centres[k] of source without shading them
+ * @param[out] powers An array of size nColumns * (windowRadius + 1). The k-th
+ *  spectrum starts at powers + k * (windowRadius + 1).
+ */
+void spectrogram_power_columns(real* const powers,
+                               struct SampleSource const* const source,
+                               size_t const* const centres, size_t nColumns,
+                               struct DSTFT* const dstfts, size_t nThreads);
+/**
+ * @brief Computes the log amplitudes which spectrogram_populate_columns shades
+ *  for the windows centred at the samples centres[k] of source
+ * @param[out] amplitudes An array of size nColumns * layout->height. The k-th
+ *  column starts at amplitudes + k * layout->height.
+ */
+void spectrogram_amplitude_columns(real* const amplitudes,
+                                   struct SampleSource const* const source,
+                                   size_t const* const centres,
+                                   size_t nColumns,
+                                   struct FrequencyLayout const* const layout,
+                                   struct DSTFT* const dstfts, size_t nThreads);
+/**
+ * @brief Shades the log amplitudes of width columns into image
+ * @param[in] amplitudes An array of size width * height. Column col starts at
+ *  amplitudes + col * height.
+ */
+void spectrogram_shade_columns(struct SpectrogramImage const* const image,
+                               real const* const amplitudes,
+                               int height, int width,
+                               struct ColourGradient const* const grad);
+/**
+ * @brief Index of the sample at the centre of the column col when n samples
+ *  are spread over width columns. Increases with col.
+ */
+size_t spectrogram_centre(int col, int width, size_t n);
+
+/**
+ * A scrolling spectrogram for streamed samples. Each column is pinned to a
+ * fixed hop of absolute sample time, so only the columns of newly captured
+ * hops need to be transformed. The columns are kept in a ring which is
+ * unwrapped by SpectrogramScroll_render.
+ */
+struct SpectrogramScroll
+{
+	int width;
+	int height;
+	/**
+	 * Number of samples between the centres of two adjacent columns
+	 */
+	size_t hop;
+	/**
+	 * Format of the rendered image. Either SPECTROGRAM_RGB24 or
+	 * SPECTROGRAM_YUV420P.
+	 */
+	enum SpectrogramFormat format;
+
+	// Populated by SpectrogramScroll_init
+	/**
+	 * The ring, in which the column slot head holds the oldest column. The
+	 * ring of a SPECTROGRAM_YUV420P scroll is in SPECTROGRAM_YUV440P.
+	 */
+	struct SpectrogramImage ring;
+	int head;
+	/**
+	 * Absolute index of the sample at the centre of the next column
+	 */
+	size_t nextCentre;
+	/**
+	 * If not NULL, the new columns are computed by this sliding DFT on the
+	 * calling thread instead of being transformed. Set to NULL by
+	 * SpectrogramScroll_init.
+	 */
+	struct SlidingDFT* sliding;
+#ifdef SPECTROGEN_PROFILE
+	/**
+	 * Times the transform and shading of the new columns if not NULL. Set to
+	 * NULL by SpectrogramScroll_init.
+	 */
+	struct Profile* profile;
+#endif
+};
+
+/**
+ * Must be called after width, height, hop and format are initialised
+ */
+void SpectrogramScroll_init(struct SpectrogramScroll* const);
+void SpectrogramScroll_destroy(struct SpectrogramScroll* const);
+/**
+ * @brief Transforms the columns whose windows have been completely captured.
+ *  Columns whose windows have already left the history are blanked. A
+ *  sliding DFT restarts if samples have been skipped since the last update.
+ * @param[in] samples The most recent nSamples samples
+ * @param[in] end Absolute index of the sample after samples[nSamples - 1]
+ * @param dstfts An array of nThreads workspaces. See
+ *  spectrogram_populate_parallel.
+ * @return The number of columns transformed
+ */
+int SpectrogramScroll_update(struct SpectrogramScroll* const,
+                             real const* const samples, size_t nSamples,
+                             size_t end,
+                             struct FrequencyLayout const* const layout,
+                             struct ColourGradient const* const grad,
+                             struct DSTFT* const dstfts, size_t nThreads);
+/**
+ * @brief Unwraps the ring of columns into image, oldest column on the left.
+ * @param[out] image An image of size width * height in the format of the
+ *  scroll
+ */
+void SpectrogramScroll_render(struct SpectrogramScroll const* const,
+                              struct SpectrogramImage const* const image);
 
 #endif // !SPECTROGEN__SPECTROGRAM_H_
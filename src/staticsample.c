@@ -6,68 +6,251 @@
 #include <math.h>
 #include <complex.h>
 #include <time.h>
+#include <string.h>
 
 #include <SDL2/SDL.h>
 #include <fftw3.h>
 
 #include "display.h"
+#include "pyramid.h"
 #include "spectrogram.h"
 
+/**
+ * Memory held by the tiles of the pyramid in bytes
+ */
+#define STATIC_SAMPLE_CACHE_SIZE ((size_t) 256 << 20)
+
+/**
+ * The part of the spectrogram on screen. Time is measured in level 0 columns
+ * of the pyramid and frequency as in FrequencyLayout_zoom.
+ */
+struct StaticView
+{
+	real begin;
+	real scale;
+	real low, high;
+};
+
+/**
+ * @brief Populates image from a stream, holding at most chunkSize samples
+ *  at a time. Consecutive chunks overlap by the window of their boundary
+ *  column, and the samples between the windows of columns are skipped.
+ */
+static bool static_sample_stream(struct SpectrogramImage const* const image,
+                                 struct Display const* const d,
+                                 struct DSTFT* const dstfts, size_t nThreads,
+                                 struct SampleStream* const stream,
+                                 size_t chunkSize)
+{
+	size_t const n = stream->nSamples;
+	size_t const width = dstfts[0].windowWidth;
+	size_t const radius = dstfts[0].windowRadius;
+	if (chunkSize < width) chunkSize = width;
+
+	real* const chunk = malloc(sizeof(real) * chunkSize);
+	size_t* const centres = malloc(sizeof(size_t) * d->width);
+	int* const columns = malloc(sizeof(int) * d->width);
+	bool success = true;
+	// chunk holds the samples [begin, end)
+	size_t begin = 0, end = 0;
+	for (int col = 0; col < d->width && success;)
+	{
+		// The window of col, clamped to the samples
+		size_t const centre = spectrogram_centre(col, d->width, n);
+		size_t const low = centre > radius ? centre - radius : 0;
+		size_t high = centre + width - radius;
+		if (high > n) high = n;
+
+		if (high > end)
+		{
+			// Keep the samples from the window of col onwards
+			size_t kept = 0;
+			if (low < end)
+			{
+				kept = end - low;
+				memmove(chunk, chunk + (low - begin), sizeof(real) * kept);
+			}
+			begin = low;
+			end = begin + chunkSize < n ? begin + chunkSize : n;
+			success = SampleStream_read(stream, chunk + kept, begin + kept,
+			                            end - begin - kept);
+			if (!success) break;
+		}
+
+		// Transform every column whose window is in the chunk
+		size_t nColumns = 0;
+		for (; col < d->width; ++col, ++nColumns)
+		{
+			size_t const c = spectrogram_centre(col, d->width, n);
+			if (c + width - radius > end && end < n) break;
+			centres[nColumns] = c - begin;
+			columns[nColumns] = col;
+		}
+		/*
+		 * Windows are only padded at the ends of the stream, where the ends of
+		 * the chunk coincide with them.
+		 */
+		struct SampleSource source;
+		SampleSource_init_array(&source, chunk, end - begin);
+		spectrogram_populate_columns(image, &source, centres, columns, nColumns,
+		                             &d->frequencyLayout, &d->colourGradient,
+		                             dstfts, nThreads);
+	}
+
+	free(chunk);
+	free(centres);
+	free(columns);
+	return success;
+}
+
+/**
+ * @brief Wraps the planes of a picture
+ */
+static void static_sample_image(struct SpectrogramImage* const image,
+                                struct Picture const* const p)
+{
+	image->format = SPECTROGRAM_YUV420P;
+	image->planes[0] = p->planeY;
+	image->planes[1] = p->planeU;
+	image->planes[2] = p->planeV;
+	image->pitches[0] = p->pitchY;
+	image->pitches[1] = image->pitches[2] = p->pitchUV;
+}
+/**
+ * @brief Draws the colour legend over the spectrogram
+ */
+static void static_sample_legend(struct SpectrogramImage const* const image,
+                                 struct Display const* const d)
+{
+	for (int i = 0; i < d->width; ++i)
+	{
+			real amp =  12 * (i / (real) d->width - 1.0);
+			//printf("%f\n", amp);
+			uint8_t yuv[3];
+			ColourGradient_eval_yuv(&d->colourGradient, amp, yuv);
+		for (int j = d->height / 10; j < d->height / 7; ++j)
+		{
+			image->planes[0][i + j * image->pitches[0]] = yuv[0];
+			if (i % 2 || j % 2) continue;
+			image->planes[1][i / 2 + j / 2 * image->pitches[1]] = yuv[1];
+			image->planes[2][i / 2 + j / 2 * image->pitches[2]] = yuv[2];
+		}
+	}
+}
+/**
+ * @brief Clamps the view to the recording and draws it. Only the tiles of the
+ *  pyramid which are not cached are computed.
+ * @return false if the display has quit
+ */
+static bool static_sample_view(struct Display* const d,
+                               struct SpectrogramPyramid* const pyramid,
+                               struct StaticView* const v,
+                               struct DSTFT* const dstfts, size_t nThreads)
+{
+	// At most the whole recording, at least 8 pixels per column
+	real const overview = pyramid->nColumns[0] / (real) d->width;
+	if (v->scale > overview) v->scale = overview;
+	if (v->scale < 1 / (real) 8) v->scale = 1 / (real) 8;
+	real const last = pyramid->nColumns[0] - v->scale * d->width;
+	if (v->begin > last) v->begin = last;
+	if (v->begin < 0) v->begin = 0;
+
+	// The constant-Q rows are cached for the whole band only
+	if (pyramid->rows)
+	{
+		v->low = 0;
+		v->high = 1;
+	}
+	real const span = v->high - v->low;
+	if (v->low < 0)
+	{
+		v->low = 0;
+		v->high = span;
+	}
+	if (v->high > 1)
+	{
+		v->high = 1;
+		v->low = 1 - span;
+	}
+	FrequencyLayout_zoom(&d->frequencyLayout, v->low, v->high);
+
+	struct Picture* p = Display_pictQueue_write(d);
+	if (!p) return false;
+	struct SpectrogramImage image;
+	static_sample_image(&image, p);
+	SpectrogramPyramid_render(pyramid, &image, d->width, v->begin, v->scale,
+	                          &d->frequencyLayout, &d->colourGradient,
+	                          dstfts, nThreads);
+	static_sample_legend(&image, d);
+	Display_pictQueue_push(d);
+	Display_pictQueue_draw(d);
+	return true;
+}
+/**
+ * @brief Zooms time by factor around the pixel x
+ */
+static void static_view_zoom(struct StaticView* const v, int x, real factor)
+{
+	real const anchor = v->begin + x * v->scale;
+	v->scale *= factor;
+	v->begin = anchor - x * v->scale;
+}
+/**
+ * @brief Zooms frequency by factor around the centre of the view
+ */
+static void static_view_zoom_frequency(struct StaticView* const v, real factor)
+{
+	real const centre = (v->low + v->high) / 2;
+	real span = (v->high - v->low) * factor;
+	if (span > 1) span = 1;
+	if (span < 1 / (real) 256) span = 1 / (real) 256;
+	v->low = centre - span / 2;
+	v->high = centre + span / 2;
+}
 
 bool static_sample_exec(struct Display* const d,
-                        struct DSTFT* const dstft,
+                        struct DSTFT* const dstfts, size_t nThreads,
                         char const* const fileName,
-                        size_t nSamplesIn)
+                        enum SampleFileType fileType,
+                        size_t nSamplesIn, size_t chunkSize)
 {
-	real* samples = NULL;
-	size_t nSamples = 0;
+	struct DSTFT const* const dstft = &dstfts[0];
+	struct SampleSource source;
+	struct SampleStream stream;
+	bool const streaming = fileName && chunkSize;
+	memset(&source, 0, sizeof(struct SampleSource));
 
 	// Populate samples
 
-	if (fileName)
+	if (streaming)
 	{
-		printf("Reading file: %s\n", fileName);
-		FILE* file = fopen(fileName, "r");
-		if (!file)
-		{
-			fprintf(stderr, "Unable to open file\n");
+		printf("Streaming file: %s\n", fileName);
+		if (!SampleStream_open(&stream, fileName, fileType))
 			return false;
-		}
-		char line[32];
-		if (!fgets(line, sizeof(line), file))
+		if (stream.nSamples < dstft->windowWidth)
 		{
-			fprintf(stderr, "File is empty\n");
-			fclose(file);
+			fprintf(stderr, "Number of samples cannot be less than the window width\n");
+			SampleStream_close(&stream);
 			return false;
 		}
-		nSamples = atol(line);
-		if (nSamples < dstft->windowWidth)
+	}
+	else if (fileName)
+	{
+		printf("Reading file: %s\n", fileName);
+		if (!SampleSource_open(&source, fileName, fileType, dstfts[0].pool))
+			return false;
+		if (source.nSamples < dstft->windowWidth)
 		{
 			fprintf(stderr, "Number of samples cannot be less than the window width\n");
-			fclose(file);
+			SampleSource_close(&source);
 			return false;
 		}
-		samples = malloc(sizeof(real) * nSamples);
-
-		for (size_t i = 0; i < nSamples; ++i)
-		{
-			if (!fgets(line, sizeof(line), file))
-			{
-				fprintf(stderr, "Sample numbers do not match\n");
-				free(samples);
-				fclose(file);
-				return false;
-			}
-			samples[i] = atof(line);
-		}
-
-		fclose(file);
 	}
 	else
 	{
 		srand(clock());
-		nSamples = nSamplesIn;
-		samples = malloc(sizeof(real) * nSamples);
+		size_t nSamples = nSamplesIn;
+		real* samples = malloc(sizeof(real) * nSamples);
 
 		size_t segmentWidth = dstft->windowWidth * 3;
 		fprintf(stdout, "Segment width: %ld\n", segmentWidth);
@@ -81,81 +264,137 @@ bool static_sample_exec(struct Display* const d,
 				samples[j] = (cos(freq0 * j) + sin(freq1 * j));
 			}
 		}
+		SampleSource_init_array(&source, samples, nSamples);
+		source.decoded = samples;
 	}
 
-	// Calculate spectrogram
-
-	uint8_t* image = malloc(3 * d->width * d->height * sizeof(uint8_t));
+	// Streams are drawn once. Other sources can be navigated.
 
 	clock_t timeStart = clock();
-	spectrogram_populate(image, d->width, d->height,
-	                     samples, nSamples, false, &d->colourGradient, dstft);
-	for (int i = 0; i < d->width; ++i)
+	struct SpectrogramPyramid pyramid;
+	struct StaticView view;
+	if (streaming)
 	{
-			double amp =  12 * (i / (real) d->width - 1.0);
-			//printf("%f\n", amp);
-		for (int j = d->height / 10; j < d->height / 7; ++j)
+		struct Picture* p = Display_pictQueue_write(d);
+		if (!p)
 		{
-			uint8_t* px = image + (i + j * d->width) * 3;
-			ColourGradient_eval(&d->colourGradient, amp, px);
+			SampleStream_close(&stream);
+			return false;
 		}
+		struct SpectrogramImage image;
+		static_sample_image(&image, p);
+		bool success = static_sample_stream(&image, d, dstfts, nThreads,
+		                                    &stream, chunkSize);
+		SampleStream_close(&stream);
+		if (!success) return false;
+		static_sample_legend(&image, d);
+		Display_pictQueue_push(d);
+		Display_pictQueue_draw(d);
 	}
-
-	clock_t timeDiff = (clock() - timeStart) * 1000 / CLOCKS_PER_SEC;
-	fprintf(stdout, "Time elapsed: %ld ms\n", timeDiff);
-
-	// Convert image to YUV
-	uint8_t const* dataIn[3];
-	int linesizeIn[3];
-
-	uint8_t* dataOut[3];
-	int linesizeOut[3];
+	else
 	{
-		dataIn[0] = dataIn[1] = dataIn[2] = image;
-		linesizeIn[0] = linesizeIn[1] = linesizeIn[2] = d->width * 3;
-		size_t pitchUV = d->width / 2;
-		linesizeOut[0] = d->width;
-		linesizeOut[1] = pitchUV;
-		linesizeOut[2] = pitchUV;
+		// Level 0 has a column per pixel of the overview, up to half a window
+		size_t hop = source.nSamples / d->width;
+		if (hop > dstft->windowRadius) hop = dstft->windowRadius;
+		if (hop < 1) hop = 1;
+		pyramid.source = &source;
+		pyramid.hop = hop;
+		pyramid.rows = d->frequencyLayout.constantQ ? &d->frequencyLayout : NULL;
+		size_t const stride = pyramid.rows ? (size_t) d->frequencyLayout.height :
+		                      dstft->windowRadius + 1;
+		pyramid.maxTiles = STATIC_SAMPLE_CACHE_SIZE /
+		  (sizeof(real) * PYRAMID_TILE_WIDTH * stride);
+		SpectrogramPyramid_init(&pyramid, dstft);
+		if (pyramid.maxTiles <= (size_t) pyramid.nLevels)
+			pyramid.maxTiles = pyramid.nLevels + 1;
+
+		view.begin = 0;
+		view.scale = pyramid.nColumns[0] / (real) d->width;
+		view.low = 0;
+		view.high = 1;
+		if (!static_sample_view(d, &pyramid, &view, dstfts, nThreads))
+		{
+			SpectrogramPyramid_destroy(&pyramid);
+			SampleSource_close(&source);
+			return false;
+		}
 	}
 
+	clock_t timeDiff = (clock() - timeStart) * 1000 / CLOCKS_PER_SEC;
+	fprintf(stdout, "Time elapsed: %ld ms\n", timeDiff);
+	if (!streaming && pyramid.rows)
+		printf("Left/Right: Pan, +/-/Wheel: Zoom, Home: Reset\n");
+	else if (!streaming)
 	{
-		struct Picture* p = &d->pictQueue[d->pictQueueIW];
-		dataOut[0] = p->planeY;
-		dataOut[1] = p->planeU;
-		dataOut[2] = p->planeV;
-
-		sws_scale(d->swsContext,
-		          dataIn, linesizeIn, 0, d->height,
-		          dataOut, linesizeOut);
-
-		++d->pictQueueIW;
-		if (d->pictQueueIW == DISPLAY_PICTQUEUE_SIZE_MAX)
-			d->pictQueueIW = 0;
-		SDL_LockMutex(d->pictQueueMutex);
-		++d->pictQueueSize;
-		SDL_UnlockMutex(d->pictQueueMutex);
-
-		Display_pictQueue_draw(d);
+		printf("Left/Right: Pan, +/-/Wheel: Zoom, "
+		       "Up/Down: Pan frequency, PageUp/PageDown: Zoom frequency, "
+		       "Home: Reset\n");
 	}
 
-	free(image);
-	free(samples);
-
 	while (true)
 	{
 		SDL_Event event;
 		SDL_WaitEvent(&event);
-		switch (event.type)
+		if (event.type == SDL_QUIT)
 		{
-		case SDL_QUIT:
 			d->quit = true;
-			goto finish;
 			break;
+		}
+		if (streaming) continue;
+
+		struct StaticView const previous = view;
+		real const page = view.scale * d->width / 4;
+		real const band = (view.high - view.low) / 4;
+		switch (event.type)
+		{
+		case SDL_KEYDOWN:
+			switch (event.key.keysym.sym)
+			{
+			case SDLK_LEFT: view.begin -= page; break;
+			case SDLK_RIGHT: view.begin += page; break;
+			case SDLK_UP: view.low += band; view.high += band; break;
+			case SDLK_DOWN: view.low -= band; view.high -= band; break;
+			case SDLK_EQUALS:
+			case SDLK_PLUS:
+			case SDLK_KP_PLUS:
+				static_view_zoom(&view, d->width / 2, 0.5);
+				break;
+			case SDLK_MINUS:
+			case SDLK_KP_MINUS:
+				static_view_zoom(&view, d->width / 2, 2);
+				break;
+			case SDLK_PAGEUP: static_view_zoom_frequency(&view, 0.5); break;
+			case SDLK_PAGEDOWN: static_view_zoom_frequency(&view, 2); break;
+			case SDLK_HOME:
+				view.begin = 0;
+				view.scale = pyramid.nColumns[0] / (real) d->width;
+				view.low = 0;
+				view.high = 1;
+				break;
+			default:
+				break;
+			}
+			break;
+		case SDL_MOUSEWHEEL:
+		{
+			int x;
+			SDL_GetMouseState(&x, NULL);
+			if (event.wheel.y > 0) static_view_zoom(&view, x, 0.5);
+			else if (event.wheel.y < 0) static_view_zoom(&view, x, 2);
+			break;
+		}
 		default:
 			break;
 		}
+		if (!memcmp(&view, &previous, sizeof(struct StaticView))) continue;
+		if (!static_sample_view(d, &pyramid, &view, dstfts, nThreads)) break;
+	}
+	if (!streaming)
+	{
+		printf("Tiles transformed: %zu, pooled: %zu\n",
+		       pyramid.nTransformed, pyramid.nPooled);
+		SpectrogramPyramid_destroy(&pyramid);
+		SampleSource_close(&source);
 	}
-finish:
 	return true;
 }
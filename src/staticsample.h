@@ -5,19 +5,20 @@
 
 #include "fourier.h"
 #include "display.h"
+#include "samplesource.h"
 
 /**
- * File format:
- * First line: [NOS]: Number of sample
- * [NOS] lines follow. Each line containing a number
- *
- * @param[in] fileName A file containing samples in a specific format
- *  (see above). If not supplied, the routine uses an internally generated
+ * @param[in] fileName A file containing samples in a format of enum
+ *  SampleFileType. If not supplied, the routine uses an internally generated
  *  set of samples
+ * @param dstfts An array of nThreads workspaces, one per calculation thread
+ * @param chunkSize If not 0, the file is streamed holding at most chunkSize
+ *  samples in memory at a time
  */
 bool static_sample_exec(struct Display* const,
-                        struct DSTFT* const,
+                        struct DSTFT* const dstfts, size_t nThreads,
                         char const* const fileName,
-                        size_t nSamplesIn);
+                        enum SampleFileType fileType,
+                        size_t nSamplesIn, size_t chunkSize);
 
 #endif // !SPECTROGEN__STATICSAMPLE_H_
@@ -0,0 +1,105 @@
+#include "workerpool.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+/**
+ * @brief Takes a task of the current call. Must hold the mutex.
+ * @return false if all tasks have been taken
+ */
+static bool workerpool_take(struct WorkerPool* const p, void** const arg)
+{
+	if (p->next >= p->nTasks) return false;
+	*arg = p->args + p->next++ * p->stride;
+	++p->nRunning;
+	return true;
+}
+/**
+ * @brief Runs tasks until none are left. Must hold the mutex, which is
+ *  released while a task runs.
+ */
+static void workerpool_drain(struct WorkerPool* const p)
+{
+	void* arg;
+	while (workerpool_take(p, &arg))
+	{
+		int (*const task)(void*) = p->task;
+		SDL_UnlockMutex(p->mutex);
+		task(arg);
+		SDL_LockMutex(p->mutex);
+		if (--p->nRunning == 0 && p->next >= p->nTasks)
+			SDL_CondSignal(p->completed);
+	}
+}
+static int workerpool_worker(struct WorkerPool* const p)
+{
+	SDL_LockMutex(p->mutex);
+	while (true)
+	{
+		while (!p->quit && p->next >= p->nTasks)
+			SDL_CondWait(p->posted, p->mutex);
+		if (p->quit) break;
+		workerpool_drain(p);
+	}
+	SDL_UnlockMutex(p->mutex);
+	return 0;
+}
+
+void WorkerPool_init(struct WorkerPool* const p)
+{
+	assert(p);
+	if (p->nThreads == 0) p->nThreads = 1;
+	p->mutex = SDL_CreateMutex();
+	p->posted = SDL_CreateCond();
+	p->completed = SDL_CreateCond();
+	p->task = NULL;
+	p->args = NULL;
+	p->stride = 0;
+	p->nTasks = p->next = p->nRunning = 0;
+	p->quit = false;
+	p->nWorkers = 0;
+	p->workers = malloc(sizeof(SDL_Thread*) * p->nThreads);
+	for (size_t t = 1; t < p->nThreads; ++t)
+	{
+		SDL_Thread* const worker =
+		  SDL_CreateThread((SDL_ThreadFunction) workerpool_worker, "worker", p);
+		if (worker) p->workers[p->nWorkers++] = worker;
+	}
+}
+void WorkerPool_destroy(struct WorkerPool* const p)
+{
+	if (!p || !p->mutex) return;
+	SDL_LockMutex(p->mutex);
+	p->quit = true;
+	SDL_CondBroadcast(p->posted);
+	SDL_UnlockMutex(p->mutex);
+	for (size_t t = 0; t < p->nWorkers; ++t)
+		SDL_WaitThread(p->workers[t], NULL);
+	free(p->workers);
+	SDL_DestroyCond(p->posted);
+	SDL_DestroyCond(p->completed);
+	SDL_DestroyMutex(p->mutex);
+	p->mutex = NULL;
+}
+void WorkerPool_exec(struct WorkerPool* const p, int (*task)(void*),
+                     void* const args, size_t stride, size_t nTasks)
+{
+	if (!p || p->nWorkers == 0 || nTasks <= 1)
+	{
+		for (size_t i = 0; i < nTasks; ++i)
+			task((char*) args + i * stride);
+		return;
+	}
+	SDL_LockMutex(p->mutex);
+	assert(p->next >= p->nTasks && p->nRunning == 0);
+	p->task = task;
+	p->args = args;
+	p->stride = stride;
+	p->nTasks = nTasks;
+	p->next = 0;
+	SDL_CondBroadcast(p->posted);
+	workerpool_drain(p);
+	while (p->nRunning)
+		SDL_CondWait(p->completed, p->mutex);
+	SDL_UnlockMutex(p->mutex);
+}
@@ -0,0 +1,72 @@
+#ifndef SPECTROGEN__WORKERPOOL_H_
+#define SPECTROGEN__WORKERPOOL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <SDL2/SDL.h>
+
+/**
+ * Threads started once which run the tasks of WorkerPool_exec. The calling
+ * thread of WorkerPool_exec takes tasks as well, so a pool of nThreads threads
+ * starts nThreads - 1 workers. The workers sleep on a condition variable
+ * between calls.
+ */
+struct WorkerPool
+{
+	/**
+	 * Number of threads running tasks, including the calling thread
+	 */
+	size_t nThreads;
+
+	// Populated by WorkerPool_init
+	size_t nWorkers;
+	SDL_Thread** workers;
+	SDL_mutex* mutex;
+	/**
+	 * Signalled when tasks are posted or the pool is destroyed
+	 */
+	SDL_cond* posted;
+	/**
+	 * Signalled when the last task completes
+	 */
+	SDL_cond* completed;
+
+	/*
+	 * The tasks of the current call: task(args + i * stride) for i in
+	 * [0, nTasks). Guarded by mutex.
+	 */
+	int (*task)(void*);
+	char* args;
+	size_t stride;
+	size_t nTasks;
+	/**
+	 * Index of the next task to take
+	 */
+	size_t next;
+	/**
+	 * Number of tasks taken but not completed
+	 */
+	size_t nRunning;
+	bool quit;
+};
+
+/**
+ * Must be called after nThreads is initialised. 0 is treated as 1. Workers
+ * which cannot be started are left out.
+ */
+void WorkerPool_init(struct WorkerPool* const);
+/**
+ * @brief Wakes and joins the workers
+ */
+void WorkerPool_destroy(struct WorkerPool* const);
+/**
+ * Only one thread may call WorkerPool_exec of a pool at a time. A NULL pool
+ * runs the tasks on the calling thread.
+ * @brief Runs task on each of the nTasks elements of stride bytes of args,
+ *  and returns once all have completed
+ */
+void WorkerPool_exec(struct WorkerPool* const, int (*task)(void*),
+                     void* const args, size_t stride, size_t nTasks);
+
+#endif // !SPECTROGEN__WORKERPOOL_H_
@@ -0,0 +1,120 @@
+#include "zoomfilter.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simd.h"
+
+/**
+ * The decimated rate is at least ZOOM_OVERSAMPLING times the bandwidth. The
+ * low-pass filter then passes half the bandwidth and stops at the Nyquist
+ * frequency less half the bandwidth, with a transition of a quarter of the
+ * decimated rate, and the band lies in [1/4, 3/4] of the output spectrum.
+ */
+#define ZOOM_OVERSAMPLING 4
+/**
+ * Taps of the filter per unit of decimation. A Blackman window needs about
+ * 5.5 / transition taps for a 74 dB stop band.
+ */
+#define ZOOM_TAPS_PER_PHASE 24
+
+bool ZoomFilter_init(struct ZoomFilter* const z)
+{
+	assert(z);
+	double const rate = z->sampleRate;
+	double const bandwidth = z->fmax - z->fmin;
+	if (z->fmin < 0 || bandwidth <= 0 || z->fmax > rate / 2)
+	{
+		fprintf(stderr, "The band must lie within [0, %g] Hz\n", rate / 2);
+		return false;
+	}
+	size_t const decimation = rate / (ZOOM_OVERSAMPLING * bandwidth);
+	if (decimation < 2)
+	{
+		fprintf(stderr, "The band must be narrower than %g Hz\n",
+		        rate / (2 * ZOOM_OVERSAMPLING));
+		return false;
+	}
+	z->decimation = decimation;
+	double const outputRate = rate / decimation;
+	z->low = 0.5 - bandwidth / outputRate;
+	z->high = 0.5 + bandwidth / outputRate;
+
+	/*
+	 * Windowed sinc with its cut off at a quarter of the decimated rate, and
+	 * unit gain at 0 Hz
+	 */
+	size_t const n = ZOOM_TAPS_PER_PHASE * decimation;
+	double const cutoff = 0.25 / decimation;
+	double const centre = (n - 1) / 2.0;
+	double* const h = malloc(sizeof(double) * n);
+	double sum = 0;
+	for (size_t k = 0; k < n; ++k)
+	{
+		double const x = k - centre;
+		double const sinc = x == 0 ? 2 * cutoff :
+		                    sin(2 * M_PI * cutoff * x) / (M_PI * x);
+		double const a = 2 * M_PI * k / (n - 1);
+		h[k] = sinc * (0.42 - 0.5 * cos(a) + 0.08 * cos(2 * a));
+		sum += h[k];
+	}
+
+	/*
+	 * Mixing the input down by fc before filtering equals filtering with the
+	 * taps mixed up by fc, and mixing the output down by fc at its instant
+	 */
+	double const mix = (z->fmin + z->fmax) / 2 / rate;
+	z->nTaps = n;
+	z->tapsRe = malloc(sizeof(real) * n);
+	z->tapsIm = malloc(sizeof(real) * n);
+	for (size_t k = 0; k < n; ++k)
+	{
+		// Tap k weights the sample k samples before the newest
+		double const angle = 2 * M_PI * fmod(mix * k, 1.0);
+		z->tapsRe[n - 1 - k] = h[k] / sum * cos(angle);
+		z->tapsIm[n - 1 - k] = h[k] / sum * sin(angle);
+	}
+	free(h);
+
+	z->history = calloc(2 * n, sizeof(real));
+	z->position = n - 1;
+	z->countdown = decimation;
+	z->phase = 0;
+	// Down by fc per input sample, then up by a quarter per output sample
+	z->step = 0.25 - fmod(mix * decimation, 1.0);
+	if (z->step < 0) z->step += 1;
+	return true;
+}
+void ZoomFilter_destroy(struct ZoomFilter* const z)
+{
+	if (!z) return;
+	free(z->tapsRe);
+	free(z->tapsIm);
+	free(z->history);
+}
+size_t ZoomFilter_process(struct ZoomFilter* const z,
+                          real const* const in, size_t n, real* const out)
+{
+	assert(z && z->history);
+	size_t const nTaps = z->nTaps;
+	size_t nOut = 0;
+	for (size_t i = 0; i < n; ++i)
+	{
+		if (++z->position == nTaps) z->position = 0;
+		z->history[z->position] = z->history[z->position + nTaps] = in[i];
+		if (--z->countdown) continue;
+		z->countdown = z->decimation;
+
+		real re, im;
+		simd_dot2(&re, &im, z->history + z->position + 1,
+		          z->tapsRe, z->tapsIm, nTaps);
+		double const angle = 2 * M_PI * z->phase;
+		out[nOut++] = 2 * (cos(angle) * re - sin(angle) * im);
+		z->phase += z->step;
+		if (z->phase >= 1) z->phase -= 1;
+	}
+	return nOut;
+}
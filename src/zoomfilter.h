@@ -0,0 +1,82 @@
+#ifndef SPECTROGEN__ZOOMFILTER_H_
+#define SPECTROGEN__ZOOMFILTER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "spectrogen.h"
+
+/**
+ * The front end of a zoom FFT. Shifts the band [fmin, fmax] of a stream of
+ * samples to the middle of a signal decimated by an integer factor D, so a
+ * transform of the decimated samples resolves the band D times finer than
+ * a transform of the same width at the original rate.
+ *
+ * The samples are mixed with a complex exponential which brings the middle
+ * of the band to 0 Hz, low-passed by a polyphase filter evaluated only at
+ * the decimated instants, and mixed up again by a quarter of the decimated
+ * rate. The real part, doubled, is a real signal which holds the band at
+ * [low, high] of its Nyquist frequency with the amplitude of the input.
+ */
+struct ZoomFilter
+{
+	/**
+	 * Sample rate of the input in Hz
+	 */
+	double sampleRate;
+	/**
+	 * The band in Hz
+	 */
+	double fmin, fmax;
+
+	// Populated by ZoomFilter_init
+	/**
+	 * D. The output has one sample for every D input samples.
+	 */
+	size_t decimation;
+	/**
+	 * The band in the output as fractions of its Nyquist frequency
+	 */
+	real low, high;
+	/**
+	 * Band-pass taps, which are the low-pass taps mixed to the middle of the
+	 * band. Reversed, so the newest sample is weighted by the last tap.
+	 */
+	size_t nTaps;
+	real* tapsRe;
+	real* tapsIm;
+	/**
+	 * The last nTaps samples, stored twice so that they are contiguous from
+	 * history + position + 1
+	 */
+	real* history;
+	size_t position;
+	/**
+	 * Number of input samples before the next output
+	 */
+	size_t countdown;
+	/**
+	 * Phase of the mixers at the next output in cycles, and its increment per
+	 * output
+	 */
+	double phase, step;
+};
+
+/**
+ * Must be called after sampleRate, fmin and fmax are initialised
+ * @return false if the band is empty, exceeds the Nyquist frequency or is too
+ *  wide to decimate. The error is printed to stderr. Nothing is allocated
+ *  then.
+ */
+bool ZoomFilter_init(struct ZoomFilter* const);
+void ZoomFilter_destroy(struct ZoomFilter* const);
+/**
+ * @brief Filters the next n input samples. The state carries over to the next
+ *  call, so a stream may be processed in blocks of any size.
+ * @param[out] out An array of size n / decimation + 1
+ * @return The number of output samples
+ */
+size_t ZoomFilter_process(struct ZoomFilter* const,
+                          real const* const in, size_t n, real* const out);
+
+#endif // !SPECTROGEN__ZOOMFILTER_H_
@@ -0,0 +1,217 @@
+/*
+ * Checks the SIMD kernels against their scalar definitions
+ *
+ * Every kernel is run on lengths around multiples of the vector width and on
+ * arrays offset from their allocation, so the remainder loops and unaligned
+ * loads are covered. Exits with a non-zero status on the first mismatch.
+ *
+ * Built against the library, the test checks the version of each kernel the
+ * CPU dispatches to. Built with src/simd.c and SIMD_TARGET or SIMD_BASELINE,
+ * it checks one version of the clones, and exits with status 77 (skipped) if
+ * the CPU lacks its target.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "simd.h"
+
+/*
+ * The tolerances documented in simd.h
+ */
+#ifdef SPECTROGEN_SINGLE_PRECISION
+#define TEST_TOLERANCE 1e-5
+#else
+#define TEST_TOLERANCE 1e-6
+#endif
+
+/**
+ * Lengths checked. The vectors hold at most 16 reals.
+ */
+static size_t const test_lengths[] =
+{
+	0, 1, 2, 3, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 100, 1023, 1536,
+};
+#define TEST_N_LENGTHS (sizeof(test_lengths) / sizeof(test_lengths[0]))
+#define TEST_MAX_LENGTH 1536
+/**
+ * Offsets in reals of the arrays from their allocation
+ */
+#define TEST_MAX_OFFSET 3
+
+static int test_failures = 0;
+
+/**
+ * @brief Deterministic xorshift64* generator, uniform on [0, 1)
+ */
+static double test_random(void)
+{
+	static uint64_t state = 0x9E3779B97F4A7C15ull;
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return (state * 0x2545F4914F6CDD1Dull >> 11) * (1.0 / 9007199254740992.0);
+}
+/**
+ * @brief Reports value if it differs from expected by more than the
+ *  tolerance, relative to scale
+ */
+static bool test_check(char const* const kernel, size_t n, size_t offset,
+                       size_t i, double value, double expected, double scale)
+{
+	if (fabs(value - expected) <= TEST_TOLERANCE * scale) return true;
+	fprintf(stderr, "%s: n = %zu, offset = %zu, i = %zu: %.17g instead of "
+	        "%.17g\n", kernel, n, offset, i, value, expected);
+	++test_failures;
+	return false;
+}
+
+/**
+ * simd_window against the scalar loop convolve was before it was vectorised
+ */
+static void test_window(real* const out, real* const in, real* const window)
+{
+	for (size_t l = 0; l < TEST_N_LENGTHS; ++l)
+	for (size_t offset = 0; offset <= TEST_MAX_OFFSET; ++offset)
+	{
+		size_t const n = test_lengths[l];
+		real* const o = out + offset;
+		real const* const x = in + offset;
+		real const* const w = window + TEST_MAX_OFFSET - offset;
+		simd_window(o, x, w, n);
+		for (size_t i = 0; i < n; ++i)
+		{
+			double const expected = (double) x[i] * w[n - 1 - i];
+			if (!test_check("simd_window", n, offset, i, o[i], expected,
+			                fabs(expected)))
+				break;
+		}
+		// In place
+		memcpy(o, x, sizeof(real) * n);
+		simd_window(o, o, w, n);
+		for (size_t i = 0; i < n; ++i)
+		{
+			double const expected = (double) x[i] * w[n - 1 - i];
+			if (!test_check("simd_window in place", n, offset, i, o[i],
+			                expected, fabs(expected)))
+				break;
+		}
+	}
+}
+static void test_power(real* const out, comp* const in)
+{
+	for (size_t l = 0; l < TEST_N_LENGTHS; ++l)
+	for (size_t offset = 0; offset <= TEST_MAX_OFFSET; ++offset)
+	{
+		size_t const n = test_lengths[l];
+		real* const o = out + offset;
+		comp const* const c = in + offset;
+		simd_power(o, c, n);
+		for (size_t i = 0; i < n; ++i)
+		{
+			double const re = creal(c[i]);
+			double const im = cimag(c[i]);
+			double const expected = re * re + im * im;
+			if (!test_check("simd_power", n, offset, i, o[i], expected,
+			                expected))
+				break;
+		}
+	}
+}
+static void test_log_amplitude(real* const values, real* const powers)
+{
+	for (size_t l = 0; l < TEST_N_LENGTHS; ++l)
+	for (size_t offset = 0; offset <= TEST_MAX_OFFSET; ++offset)
+	{
+		size_t const n = test_lengths[l];
+		real* const v = values + offset;
+		real const* const p = powers + offset;
+		memcpy(v, p, sizeof(real) * n);
+		simd_log_amplitude(v, n);
+		for (size_t i = 0; i < n; ++i)
+		{
+			double const expected = 0.5 * log((double) p[i]) + M_LN2;
+			if (!test_check("simd_log_amplitude", n, offset, i, v[i], expected,
+			                1.0))
+				break;
+		}
+	}
+
+	// Zero maps to -infinity
+	real zero[3] = { 0, 1, 0 };
+	simd_log_amplitude(zero, 3);
+	if (!isinf(zero[0]) || zero[0] > 0 || !isinf(zero[2]) || zero[2] > 0)
+	{
+		fprintf(stderr, "simd_log_amplitude: zero maps to %g\n", zero[0]);
+		++test_failures;
+	}
+}
+static void test_dot2(real* const x, real* const a, real* const b)
+{
+	for (size_t l = 0; l < TEST_N_LENGTHS; ++l)
+	for (size_t offset = 0; offset <= TEST_MAX_OFFSET; ++offset)
+	{
+		size_t const n = test_lengths[l];
+		real const* const vx = x + offset;
+		real const* const va = a + TEST_MAX_OFFSET - offset;
+		real const* const vb = b + offset;
+		double expectedA = 0, expectedB = 0, scale = 0;
+		for (size_t i = 0; i < n; ++i)
+		{
+			expectedA += (double) va[i] * vx[i];
+			expectedB += (double) vb[i] * vx[i];
+			scale += fabs((double) va[i] * vx[i]) + fabs((double) vb[i] * vx[i]);
+		}
+		real dotA, dotB;
+		simd_dot2(&dotA, &dotB, vx, va, vb, n);
+		test_check("simd_dot2 a", n, offset, 0, dotA, expectedA, scale);
+		test_check("simd_dot2 b", n, offset, 0, dotB, expectedB, scale);
+	}
+}
+
+int main(void)
+{
+#ifdef SIMD_TARGET
+	if (!__builtin_cpu_supports(SIMD_TARGET))
+	{
+		fprintf(stdout, "Skipped: the CPU does not support %s\n", SIMD_TARGET);
+		return 77;
+	}
+#endif
+	size_t const size = TEST_MAX_LENGTH + TEST_MAX_OFFSET;
+	real* const a = malloc(sizeof(real) * size);
+	real* const b = malloc(sizeof(real) * size);
+	real* const c = malloc(sizeof(real) * size);
+	real* const powers = malloc(sizeof(real) * size);
+	comp* const spectrum = malloc(sizeof(comp) * size);
+	for (size_t i = 0; i < size; ++i)
+	{
+		a[i] = 2 * test_random() - 1;
+		b[i] = 2 * test_random() - 1;
+		// Powers over many octaves
+		powers[i] = exp(-60 + 90 * test_random());
+		spectrum[i] = (real) (100 * (test_random() - 0.5)) +
+		              I * (real) (100 * (test_random() - 0.5));
+	}
+
+	test_window(c, a, b);
+	test_power(c, spectrum);
+	test_log_amplitude(c, powers);
+	test_dot2(a, b, c);
+
+	free(a);
+	free(b);
+	free(c);
+	free(powers);
+	free(spectrum);
+	if (test_failures)
+	{
+		fprintf(stderr, "%d failures\n", test_failures);
+		return 1;
+	}
+	fprintf(stdout, "All SIMD kernels match\n");
+	return 0;
+}